@@ -0,0 +1,233 @@
+#ifndef __AUTOSAVE_INCLUDED__
+#define __AUTOSAVE_INCLUDED__
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <system_error>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include "JobSystem.cpp"
+#include "Profiler.cpp"
+#include "Project.cpp"
+#include "RIFFLoader.cpp"
+#include "Utils.cpp"
+
+// Autosaving:
+
+/*  Once the project has changed and the interval has
+    passed since the last autosave, update() copies the
+    project and saves the copy on a worker, so the UI
+    thread only pays for the copy. That is cheap, since
+    the pattern data is shared and copy-on-write (see
+    PatternPool.cpp): copying a song copies pointers, and
+    edits made while the save runs copy just the patterns
+    they touch. Songs not loaded yet stay shared with the
+    file they're in the same way.
+
+    The file is written next to its final path first,
+    synced to the disk and renamed over it once complete
+    (syncing the directory too on POSIX, so the rename
+    sticks), so a crash, a power cut or a full disk mid-save
+    leaves the previous autosave intact. Every process gets
+    its own default path, so two editors open at once don't
+    overwrite each other's autosave.
+
+    Only one autosave runs at a time. The chunks it
+    encoded are handed back to the project afterwards (see
+    Song::adoptChunkCache()), so the next save of any kind
+    doesn't encode them again.
+*/
+
+class Autosave {
+    public:
+        static constexpr int64_t DEFAULT_INTERVAL = 60000000000;   // In nanoseconds
+
+        struct Stats {
+            int64_t snapshotTime;   // Spent copying the project on the UI thread, in nanoseconds
+            int64_t saveTime;       // Spent encoding and writing it on a worker, in nanoseconds
+            uint64_t saves;         // That succeeded
+            bool failed;            // Whether the last one failed
+        };
+
+        Autosave (std::string path = defaultPath(), int64_t interval = DEFAULT_INTERVAL) : target(std::move(path)), interval(interval) {};
+
+        // In the temporary directory, named after the process ID
+        static std::string defaultPath ();
+
+        /**
+         * @brief Starts an autosave if it's due, call once per frame on the UI thread
+         * @param changes A counter of the changes made to the project, e.g. UndoHistory::changes()
+         * @return Whether one was started
+         */
+        bool update (Project & project, uint64_t changes, int64_t time = Profiler::now());
+
+        /**
+         * @brief Starts an autosave right away, unless one is already running
+         * @note The project has to outlive the autosave, its continuation updates the project's chunk cache
+         */
+        bool saveNow (Project & project, uint64_t changes, int64_t time = Profiler::now());
+
+        /**
+         * @brief Get how long until update() starts an autosave, to know when to wake up for it
+         * @return In nanoseconds, -1 if it won't without further changes
+         */
+        int64_t timeUntilDue (uint64_t changes, int64_t time = Profiler::now()) const;
+
+        /**
+         * @brief Writes the project to a temporary file, then renames it to path
+         * @return Whether it's been saved
+         */
+        static bool write (const Project & project, const std::string & path);
+
+        bool isSaving () const { return group && !group->isDone(); };
+        // Waits for the running autosave to finish, its continuation still has to run
+        void wait () { if (group) group->wait(); };
+
+        const Stats & stats () const { return lastStats; };
+        const std::string & path () const { return target; };
+
+    private:
+        /**
+         * @brief Flushes a file or directory to the disk
+         * @note Directories can only be synced on POSIX, elsewhere this does nothing for them
+         * @return Whether it's been synced
+         */
+        static bool sync (const std::string & path, bool directory = false);
+
+        std::string target;
+        int64_t interval;
+        int64_t lastStart = -1;     // -1 until the first update(), which starts the interval
+        uint64_t savedChanges = 0;  // The change counter as of the last successful autosave
+        JobSystem::Group group;
+        Stats lastStats {};
+};
+
+#pragma region implementation
+
+std::string Autosave::defaultPath () {
+    std::error_code error;
+    auto directory = std::filesystem::temp_directory_path(error);
+    #ifdef _WIN32
+        unsigned long process = GetCurrentProcessId();
+    #else
+        unsigned long process = getpid();
+    #endif
+    auto name = "genecyzer-autosave-" + std::to_string(process) + ".gczr";
+    return (error ? std::filesystem::path(".") : directory).append(name).string();
+}
+
+int64_t Autosave::timeUntilDue (uint64_t changes, int64_t time) const {
+    if (changes == savedChanges || isSaving()) return -1;
+    if (lastStart < 0) return interval;
+    return std::max<int64_t>(lastStart + interval - time, 0);
+}
+
+bool Autosave::update (Project & project, uint64_t changes, int64_t time) {
+    if (lastStart < 0) lastStart = time;
+    int64_t due = timeUntilDue(changes, time);
+    if (due != 0) return false;
+    return saveNow(project, changes, time);
+}
+
+bool Autosave::saveNow (Project & project, uint64_t changes, int64_t time) {
+    if (isSaving()) return false;
+    lastStart = time;
+
+    int64_t start = Profiler::now();
+    std::shared_ptr<const Project> snapshot;
+    {
+        PROFILE_SCOPE("Autosave snapshot");
+        snapshot = std::make_shared<const Project>(project);
+    }
+    lastStats.snapshotTime = Profiler::now() - start;
+
+    // Only touched by the job, then by the continuation once it's done
+    struct Result {
+        bool saved = false;
+        int64_t time = 0;
+    };
+    auto result = std::make_shared<Result>();
+
+    group = JobSystem::createGroup();
+    JobSystem::submit(group, [snapshot, result, path = target](const JobSystem::TaskGroup &){
+        int64_t start = Profiler::now();
+        result->saved = write(*snapshot, path);
+        result->time = Profiler::now() - start;
+    });
+    JobSystem::then(group, [this, &project, snapshot, result, changes]{
+        lastStats.saveTime = result->time;
+        lastStats.failed = !result->saved;
+        if (!result->saved) {
+            err("Could not autosave to %s\n", target.c_str());
+            return;     // Tried again after the interval, as the changes are still unsaved
+        }
+        lastStats.saves++;
+        savedChanges = changes;
+        for (size_t i = 0; i < project.songs.size() && i < snapshot->songs.size(); i++)
+            project.songs[i].adoptChunkCache(snapshot->songs[i]);
+    });
+    return true;
+}
+
+bool Autosave::write (const Project & project, const std::string & path) {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        if (!file) return false;
+        project.Save(file);
+        file.close();
+        if (!file) return false;
+    }
+    std::error_code error;
+    if (!sync(temporary)) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    auto directory = std::filesystem::path(path).parent_path();
+    sync(directory.empty() ? "." : directory.string(), true);
+    return true;
+}
+
+#ifdef _WIN32
+
+bool Autosave::sync (const std::string & path, bool directory) {
+    if (directory) return true;
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    bool synced = FlushFileBuffers(file);
+    CloseHandle(file);
+    return synced;
+}
+
+#else
+
+bool Autosave::sync (const std::string & path, bool directory) {
+    int descriptor = ::open(path.c_str(), directory ? O_RDONLY | O_DIRECTORY : O_WRONLY);
+    if (descriptor < 0) return false;
+    bool synced = fsync(descriptor) == 0;
+    ::close(descriptor);
+    return synced;
+}
+
+#endif
+
+#pragma endregion
+
+#endif  // __AUTOSAVE_INCLUDED__
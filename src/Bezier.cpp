@@ -1,4 +1,5 @@
 #include "Utils.cpp"
+#include "RenderStats.cpp"
 #include <SFML/System.hpp>
 #include <SFML/Graphics.hpp>
 #include <array>
@@ -123,11 +124,11 @@ void CubicBezier::calculate(std::array<sf::Vector2f, 4>& points, float precision
 
 void CubicBezier::draw (sf::RenderTarget &target, sf::RenderStates states) const {
     #ifdef BEZIER_DEBUG
-    target.draw(lines, states);
+    RenderStats::draw(target, lines, states);
     #endif
-    target.draw(vertices, states);
+    RenderStats::draw(target, vertices, states);
     #ifdef BEZIER_DEBUG
-    if (center.getVertexCount() > 0) target.draw(center);
+    if (center.getVertexCount() > 0) RenderStats::draw(target, center);
     #endif
 }
 
@@ -1,132 +1,121 @@
 #ifndef __BITCONVERTER_INCLUDED__
 #define __BITCONVERTER_INCLUDED__
 
+#include <array>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
 #ifdef BITCONVERTER_VECTOR_CONVS
 #include <vector>
 #endif
-#ifdef BITCONVERTER_ARRAY_CONVS
-#include <array>
-#endif
+
+// Little-endian conversions:
+
+/*	The project files are little-endian. Reads and writes
+	go through memcpy, so pointers don't have to be aligned
+	and nothing is type-punned: on little-endian systems it
+	compiles to a plain load or store, on big-endian ones
+	the bytes get swapped on the way, which compilers turn
+	into a single instruction (and vectorize in the bulk
+	conversions, readArray() and writeArray()).
+
+	The conversions between values and std::arrays of bytes
+	are constexpr.
+*/
 
 namespace BitConverter {
 
-#if !defined(__BIG_ENDIAN_OVERRIDE) && ( \
-	defined(__BYTE_ORDER) && __BYTE_ORDER == __LITTLE_ENDIAN || \
-	defined(__LITTLE_ENDIAN__) || \
-	defined(__ARMEL__) || \
-	defined(__THUMBEL__) || \
-	defined(__AARCH64EL__) || \
-	defined(_MIPSEL) || defined(__MIPSEL) || defined(__MIPSEL__) )
-
-// system is natively little-endian, no conversion needed
-
-// Write a uint64_t to ptr, exists for portability with big-endian systems
-inline void writeBytes (void * ptr, uint64_t input) { *(uint64_t *)ptr = input; }
-
-// Write a uint32_t to ptr, exists for portability with big-endian systems
-inline void writeBytes (void * ptr, uint32_t input) { *(uint32_t *)ptr = input; }
-
-// Write a uint16_t to ptr, exists for portability with big-endian systems
-inline void writeBytes (void * ptr, uint16_t input) { *(uint16_t *)ptr = input; }
-
-// Read a uint64_t from ptr, exists for portability with big-endian systems
-inline uint64_t readUint64 (const void * ptr) {return *(uint64_t *) ptr;}
-
-// Read a uint32_t from ptr, exists for portability with big-endian systems
-inline uint32_t readUint32 (const void * ptr) {return *(uint32_t *) ptr;}
-
-// Read a uint16_t from ptr, exists for portability with big-endian systems
-inline uint16_t readUint16 (const void * ptr) {return *(uint16_t *) ptr;}
-
-#elif defined(__BIG_ENDIAN_OVERRIDE) || \
-	defined(__BYTE_ORDER) && __BYTE_ORDER == __BIG_ENDIAN || \
-	defined(__BIG_ENDIAN__) || \
-	defined(__ARMEB__) || \
-	defined(__THUMBEB__) || \
-	defined(__AARCH64EB__) || \
-	defined(_MIBSEB) || defined(__MIBSEB) || defined(__MIBSEB__) || \
-	defined(_MSC_VER)   // MSVC YOU FUCKING SON OF A BITCH
-
-// system is natively big-endian (or undetermined in case of MSVC), conversion required
-
-// Write a uint64_t to ptr, while converting it to little-endian
-inline void writeBytes (void * ptr, uint64_t input) {
-	uint8_t * tmp = (uint8_t*) ptr; 
-	*(tmp  )= (input    )&0xFF;
-	*(tmp+1)= (input>> 8)&0xFF;
-	*(tmp+2)= (input>>16)&0xFF;
-	*(tmp+3)= (input>>24)&0xFF;
-	*(tmp+4)= (input>>32)&0xFF;
-	*(tmp+5)= (input>>40)&0xFF;
-	*(tmp+6)= (input>>48)&0xFF;
-	*(tmp+7)= (input>>56)&0xFF;
-}
+static_assert(std::endian::native == std::endian::little || std::endian::native == std::endian::big,
+	"Mixed-endian systems are not supported");
 
-// Write a uint32_t to ptr, while converting it to little-endian
-inline void writeBytes (void * ptr, uint32_t input) {
-	uint8_t * tmp = (uint8_t*) ptr; 
-	*(tmp  )= (input    )&0xFF;
-	*(tmp+1)= (input>> 8)&0xFF;
-	*(tmp+2)= (input>>16)&0xFF;
-	*(tmp+3)= (input>>24)&0xFF;
-}
+// Whether the native byte order differs from the files'
+constexpr bool SWAP_BYTES = std::endian::native == std::endian::big;
 
-// Write a uint16_t to ptr, while converting it to little-endian
-inline void writeBytes (void * ptr, uint16_t input) {
-	uint8_t * tmp = (uint8_t*) ptr; 
-	*(tmp  )= (input    )&0xFF;
-	*(tmp+1)= (input>> 8)&0xFF;
+// Reverses the bytes of an unsigned integer, as std::byteswap is C++23
+template <class T>
+constexpr T byteswap (T value) {
+	static_assert(std::is_unsigned_v<T>, "Only unsigned integers can be byteswapped");
+	T output = 0;
+	for (size_t i = 0; i < sizeof(T); i++, value >>= 8)
+		output = (T)(output << 8 | (value & 0xFF));
+	return output;
 }
 
-// Read a uint64_t from ptr in little-endian
-inline uint64_t readUint64 (const void * ptr) {
-	uint8_t * tmp = (uint8_t*) ptr; 
-	return \
-		(uint64_t)*(tmp  )    |
-		(uint64_t)*(tmp+1)<< 8|
-		(uint64_t)*(tmp+2)<<16|
-		(uint64_t)*(tmp+3)<<24|
-		(uint64_t)*(tmp+4)<<32|
-		(uint64_t)*(tmp+5)<<40|
-		(uint64_t)*(tmp+6)<<48|
-		(uint64_t)*(tmp+7)<<56;
+// Converts from native to little-endian, or back
+template <class T>
+constexpr T toLittleEndian (T value) {
+	if constexpr (SWAP_BYTES) return byteswap(value);
+	else return value;
 }
 
-// Read a uint32_t from ptr in little-endian
-inline uint32_t readUint32 (const void * ptr) {
-	uint8_t * tmp = (uint8_t*) ptr; 
-	return \
-		(uint32_t)*(tmp  )    |
-		(uint32_t)*(tmp+1)<< 8|
-		(uint32_t)*(tmp+2)<<16|
-		(uint32_t)*(tmp+3)<<24;
+// The bytes of a value, in little-endian
+template <class T>
+constexpr std::array<uint8_t, sizeof(T)> toBytes (T value) {
+	return std::bit_cast<std::array<uint8_t, sizeof(T)>>(toLittleEndian(value));
 }
 
-// Read a uint16_t from ptr in little-endian
-inline uint16_t readUint16 (const void * ptr) {
-	uint8_t * tmp = (uint8_t*) ptr; 
-	return *(tmp) | *(tmp+1)<<8;
+// A value from its bytes in little-endian
+template <class T>
+constexpr T fromBytes (const std::array<uint8_t, sizeof(T)> & bytes) {
+	return toLittleEndian(std::bit_cast<T>(bytes));
 }
 
-#else
-#error "Unsupported architecture. Please contact the lead dev and report what architecture you're compiling on"
-#endif
-
-// Architecture independent funcs
+// Read a little-endian value from ptr, which doesn't have to be aligned
+template <class T>
+inline T read (const void * ptr) {
+	T value;
+	memcpy(&value, ptr, sizeof(T));
+	return toLittleEndian(value);
+}
 
-#ifdef BITCONVERTER_ARRAY_CONVS
-std::array<uint8_t, 2> toByteArray(uint16_t data) {
-	std::array<uint8_t, 2> output; writeBytes(output.data(), data); return output;
+// Write a value to ptr in little-endian, ptr doesn't have to be aligned
+template <class T>
+inline void write (void * ptr, T value) {
+	value = toLittleEndian(value);
+	memcpy(ptr, &value, sizeof(T));
 }
 
-std::array<uint8_t, 4> toByteArray(uint32_t data) {
-	std::array<uint8_t, 4> output; writeBytes(output.data(), data); return output;
+inline void writeBytes (void * ptr, uint64_t input) { write(ptr, input); }
+inline void writeBytes (void * ptr, uint32_t input) { write(ptr, input); }
+inline void writeBytes (void * ptr, uint16_t input) { write(ptr, input); }
+
+inline uint64_t readUint64 (const void * ptr) { return read<uint64_t>(ptr); }
+inline uint32_t readUint32 (const void * ptr) { return read<uint32_t>(ptr); }
+inline uint16_t readUint16 (const void * ptr) { return read<uint16_t>(ptr); }
+
+/**
+ * @brief Reads output.size() little-endian values at once
+ * @param input Has to hold output.size_bytes() bytes, doesn't have to be aligned
+ */
+template <class T, size_t N>
+inline void readArray (const void * input, std::span<T, N> output) {
+	if (output.empty()) return;
+	memcpy(output.data(), input, output.size_bytes());
+	if constexpr (SWAP_BYTES)
+		for (auto & value : output) value = byteswap(value);
 }
 
-std::array<uint8_t, 8> toByteArray(uint64_t data) {
-	std::array<uint8_t, 8> output; writeBytes(output.data(), data); return output;
+/**
+ * @brief Writes every value in little-endian at once
+ * @param output Has to have room for input.size_bytes() bytes, doesn't have to be aligned
+ */
+template <class T, size_t N>
+inline void writeArray (void * output, std::span<T, N> input) {
+	if (input.empty()) return;
+	if constexpr (SWAP_BYTES)
+		for (size_t i = 0; i < input.size(); i++) write((uint8_t *)output + i * sizeof(T), (std::remove_const_t<T>)input[i]);
+	else memcpy(output, input.data(), input.size_bytes());
 }
+
+// Architecture independent funcs
+
+#ifdef BITCONVERTER_ARRAY_CONVS
+constexpr std::array<uint8_t, 2> toByteArray(uint16_t data) { return toBytes(data); }
+constexpr std::array<uint8_t, 4> toByteArray(uint32_t data) { return toBytes(data); }
+constexpr std::array<uint8_t, 8> toByteArray(uint64_t data) { return toBytes(data); }
 #endif // BITCONVERTER_ARRAY_CONVS
 
 #ifdef BITCONVERTER_VECTOR_CONVS
@@ -141,8 +130,24 @@ std::vector<uint8_t> toVector(uint32_t data) {
 std::vector<uint8_t> toVector(uint64_t data) {
 	std::vector<uint8_t> output(8); writeBytes(output.data(), data); return output;
 }
+
+// Appends a value in little-endian, without a temporary
+template <class T>
+inline void append (std::vector<uint8_t> & output, T value) {
+	size_t size = output.size();
+	output.resize(size + sizeof(T));
+	write(output.data() + size, value);
+}
+
+// Appends every value in little-endian at once, e.g. append(output, std::span(values))
+template <class T, size_t N>
+inline void appendArray (std::vector<uint8_t> & output, std::span<T, N> values) {
+	size_t size = output.size();
+	output.resize(size + values.size_bytes());
+	writeArray(output.data() + size, values);
+}
 #endif // BITCONVERTER_VECTOR_CONVS
 
 }   // namespace BitConverter
 
-#endif  // __BITCONVERTER_INCLUDED__
\ No newline at end of file
+#endif  // __BITCONVERTER_INCLUDED__
@@ -2,7 +2,9 @@
 #pragma region header
 
 #include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
 #include "Tile.cpp"
+#include "Profiler.cpp"
 #include <vector>
 
 #ifndef __CACHED_TILE_INCLUDED__
@@ -329,6 +331,13 @@ class AutoCachedTileMatrix : public TileMatrix {
          */
         sf::Texture renderToTexture() const { return cachedTexture.getTexture(); };
 
+        /**
+         * @brief Finishes the tiles cached since the last call and flushes them to the GPU
+         * @note Has to be called by the thread that changed the tiles before another
+         * GL context (e.g. the render thread's) draws the matrix
+         */
+        void display();
+
         #pragma endregion
 
         static constexpr uint8_t HFLIP = 0x01;
@@ -366,6 +375,7 @@ class AutoCachedTileMatrix : public TileMatrix {
         }
 
         sf::RenderTexture cachedTexture;
+        bool pendingDisplay = false;    // Tiles have been cached since the last display()
 
         sf::Vertex vertices[4];
 
@@ -376,12 +386,13 @@ class AutoCachedTileMatrix : public TileMatrix {
 #pragma region cachingTexture
 
 void AutoCachedTileMatrix::cacheTexture(uint16_t __x, uint16_t __y, uint16_t __width, uint16_t __height) {
+    PROFILE_SCOPE("AutoCachedTileMatrix::cacheTexture");
     sf::Vector2f texturePos {0, 0};
     uint8_t flip_palette;
     sf::Color color;
     if (getTexture() == nullptr) return;
+    pendingDisplay = true;
     for (uint16_t i = __y; i < (__y + __height); i++){
-        uint16_t y = getHeight() - i - 1;
         for (uint16_t j = __x; j < (__x + __width); j++){
             flip_palette = tiles[i][j].flip_palette;
             texturePos = sf::Vector2f(
@@ -393,35 +404,44 @@ void AutoCachedTileMatrix::cacheTexture(uint16_t __x, uint16_t __y, uint16_t __w
                 flip_palette&GRNMASK?255:0,
                 flip_palette&BLUMASK?255:0);
             sf::Vertex vertices[4] = {
-                sf::Vertex{sf::Vector2f(j*TILE_SIZE,            y*TILE_SIZE+TILE_SIZE),
+                sf::Vertex{sf::Vector2f(j*TILE_SIZE,            i*TILE_SIZE+TILE_SIZE),
                     color, texturePos+sf::Vector2f(
                         flip_palette&HFLIP?TILE_SIZE:0,
-                        flip_palette&VFLIP?TILE_SIZE:0)
+                        flip_palette&VFLIP?0:TILE_SIZE)
                     },
-                sf::Vertex{sf::Vector2f(j*TILE_SIZE+TILE_SIZE,  y*TILE_SIZE+TILE_SIZE),
+                sf::Vertex{sf::Vector2f(j*TILE_SIZE+TILE_SIZE,  i*TILE_SIZE+TILE_SIZE),
                     color, texturePos+sf::Vector2f(
                         flip_palette&HFLIP?0:TILE_SIZE,
-                        flip_palette&VFLIP?TILE_SIZE:0)
+                        flip_palette&VFLIP?0:TILE_SIZE)
                     },
-                sf::Vertex{sf::Vector2f(j*TILE_SIZE+TILE_SIZE,  y*TILE_SIZE),
+                sf::Vertex{sf::Vector2f(j*TILE_SIZE+TILE_SIZE,  i*TILE_SIZE),
                     color, texturePos+sf::Vector2f(
                         flip_palette&HFLIP?0:TILE_SIZE,
-                        flip_palette&VFLIP?0:TILE_SIZE)
+                        flip_palette&VFLIP?TILE_SIZE:0)
                     },
-                sf::Vertex{sf::Vector2f(j*TILE_SIZE,            y*TILE_SIZE),
+                sf::Vertex{sf::Vector2f(j*TILE_SIZE,            i*TILE_SIZE),
                     color, texturePos+sf::Vector2f(
                         flip_palette&HFLIP?TILE_SIZE:0,
-                        flip_palette&VFLIP?0:TILE_SIZE)
+                        flip_palette&VFLIP?TILE_SIZE:0)
                     }
             };
-            cachedTexture.draw(vertices, 4, sf::PrimitiveType::TriangleFan, sf::RenderStates(getTexture()));
+            RenderStats::draw(cachedTexture, vertices, 4, sf::PrimitiveType::TriangleFan, sf::RenderStates(getTexture()));
         }
     }
 }
 
+void AutoCachedTileMatrix::display() {
+    if (!pendingDisplay) return;
+    // Resolves the render texture (and flips it the right way up), then makes sure its
+    // commands reach the GPU, as the render thread samples it from the window's context
+    cachedTexture.display();
+    glFlush();
+    pendingDisplay = false;
+}
+
 void AutoCachedTileMatrix::draw(sf::RenderTarget& target, sf::RenderStates states) const {
     states.texture = &cachedTexture.getTexture();
-    target.draw(vertices, 4, sf::PrimitiveType::TriangleFan, states);
+    RenderStats::draw(target, vertices, 4, sf::PrimitiveType::TriangleFan, states);
 }
 
 #pragma endregion
@@ -2,6 +2,7 @@
 
 #include <SFML/Graphics.hpp>
 #include "Tile.cpp"
+#include "RenderStats.cpp"
 #include <vector>
 
 #ifndef __CHRFONT_INCLUDED__
@@ -21,8 +22,12 @@ class ChrFont {
         uint32_t chrDataSize;
         sf::Texture texture;
         std::vector<uint32_t> codepages;
+        // Unique to every init() of every font, so what's derived from a font can tell when it's outdated
+        uint64_t generation = 0;
     private:
         void init_common(const void* chrData, uint32_t size, bool inverted);
+
+        inline static uint64_t lastGeneration = 0;
 };
 
 #pragma endregion
@@ -44,6 +49,7 @@ void ChrFont::init_common(const void* __chrData, uint32_t size, bool inverted){
     auto chrData = (const uint8_t *)__chrData;
     this->chrDataPtr = chrData;
     this->chrDataSize = size;
+    this->generation = ++lastGeneration;
 
     uint8_t colorBuffer[TILE_SIZE*TILE_SIZE];
     uint32_t amount = size>>4;
@@ -102,7 +108,7 @@ void ChrFont::init_common(const void* __chrData, uint32_t size, bool inverted){
         }
     }
     texture.resize({inverted ? 2*TILE_SIZE : TILE_SIZE, TILE_SIZE*amount});
-    texture.update(pixels);
+    RenderStats::update(texture, pixels);
     texture.setSmooth(false);
 
     delete[] pixels;
@@ -1,9 +1,14 @@
 #ifndef __EFFECT_INCLUDED__
 #define __EFFECT_INCLUDED__
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <vector>
 
+#include "Hash.cpp"
+#include "Log.cpp"
+
 #pragma region classDefinitions
 
 class EffectBase {
@@ -11,19 +16,74 @@ class EffectBase {
     std::vector<uint8_t> params;
 
     public:
+        EffectBase(uint8_t id = 0, std::vector<uint8_t> params = {}) : id(id), params(params) {};
+
+        uint8_t getId () const { return id; };
+        const std::vector<uint8_t> & getParams () const { return params; };
+
         const bool operator==(const EffectBase & other) const;
         const bool operator!=(const EffectBase & other) const;
 };
 
+// Fixed size version of EffectBase, stored inline in the
+// pattern data so that a row's effects need no allocations.
+// Every id is a valid effect, so unused slots are marked by
+// their parameter count instead.
+struct EffectSlot {
+    static constexpr uint8_t EMPTY = 0xFF;      // paramCount of an unused slot
+    static constexpr size_t MAX_PARAMS = 3;
+
+    uint8_t id = 0;
+    uint8_t paramCount = EMPTY;
+    std::array<uint8_t, MAX_PARAMS> params {};
+
+    bool empty () const { return paramCount == EMPTY; };
+    size_t paramSize () const { return empty() ? 0 : paramCount; };
+
+    bool operator== (const EffectSlot & other) const {
+        return id == other.id && paramCount == other.paramCount &&
+            std::equal(params.begin(), params.begin() + paramSize(), other.params.begin());
+    };
+
+    /**
+     * @brief Converts an effect into a slot
+     * @note Parameters past MAX_PARAMS don't fit and are dropped, with a warning
+     */
+    static EffectSlot fromEffect (const EffectBase & effect) {
+        EffectSlot slot;
+        slot.id = effect.getId();
+        if (effect.getParams().size() > MAX_PARAMS)
+            LOG_WARNING("Effect %02X has %zu parameters, only the first %zu are kept\n", effect.getId(), effect.getParams().size(), MAX_PARAMS);
+        slot.paramCount = std::min(effect.getParams().size(), MAX_PARAMS);
+        std::copy_n(effect.getParams().begin(), slot.paramCount, slot.params.begin());
+        return slot;
+    };
+    /**
+     * @brief Converts the slot back into an effect
+     * @note An empty slot gives an effect with id 0 and no parameters
+     */
+    EffectBase toEffect () const {
+        if (empty()) LOG_WARNING("Converting an empty effect slot\n");
+        return EffectBase(id, std::vector<uint8_t>(params.begin(), params.begin() + paramSize()));
+    };
+};
+
 #pragma endregion
 
 #pragma region stdInserts
 
+// Both hash the same for the same effect
 template <>
 struct std::hash<EffectBase> {
-    size_t operator()(const EffectBase & cell) const noexcept {
-        //TODO
-        return 0;
+    size_t operator()(const EffectBase & effect) const noexcept {
+        return Hash::bytes(effect.getParams().data(), effect.getParams().size(), Hash::combine(Hash::SEED, effect.getId()));
+    }
+};
+
+template <>
+struct std::hash<EffectSlot> {
+    size_t operator()(const EffectSlot & effect) const noexcept {
+        return Hash::bytes(effect.params.data(), effect.paramSize(), Hash::combine(Hash::SEED, effect.id));
     }
 };
 
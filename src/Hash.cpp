@@ -0,0 +1,56 @@
+#ifndef __HASH_INCLUDED__
+#define __HASH_INCLUDED__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Non-allocating hashing helpers, for the std::hash
+// specializations of the tracker data. Not cryptographic,
+// just fast and well-mixed enough for hash maps.
+
+namespace Hash {
+
+constexpr uint64_t SEED = 0x9E3779B97F4A7C15;
+
+/**
+ * @brief The splitmix64 finalizer, every input bit affects every output bit
+ */
+constexpr uint64_t mix (uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EB;
+    value ^= value >> 31;
+    return value;
+}
+
+/**
+ * @brief Folds a value into a running hash, order-dependent
+ */
+constexpr uint64_t combine (uint64_t hash, uint64_t value) {
+    return mix(hash + SEED + value);
+}
+
+/**
+ * @brief Hashes a byte string, 8 bytes at a time
+ */
+inline uint64_t bytes (const void * data, size_t size, uint64_t hash = SEED) {
+    auto * ptr = (const uint8_t *)data;
+    hash = combine(hash, size);
+    for (; size >= 8; size -= 8, ptr += 8) {
+        uint64_t word;
+        memcpy(&word, ptr, 8);
+        hash = combine(hash, word);
+    }
+    if (size) {
+        uint64_t word = 0;
+        memcpy(&word, ptr, size);
+        hash = combine(hash, word);
+    }
+    return hash;
+}
+
+}   // namespace Hash
+
+#endif  // __HASH_INCLUDED__
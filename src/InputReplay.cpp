@@ -0,0 +1,180 @@
+#ifndef __INPUT_REPLAY_INCLUDED__
+#define __INPUT_REPLAY_INCLUDED__
+
+#include <SFML/Window.hpp>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+#include "Utils.cpp"
+
+// Input recording and replaying:
+
+/*  A recording is a text file with one event per line:
+        <frame> <event name> <arguments...>
+    where frame is the number of the main loop iteration
+    (ProcessEvents + Update) the event was handled in.
+    Replaying feeds every frame's events back in the same
+    grouping, one Update per recorded frame, without any
+    waiting in between, so the results only depend on the
+    recording and not on how fast it was recorded.
+
+    Events that don't matter to Genecyzer (e.g. TextEntered,
+    joystick stuff) are not recorded.
+*/
+
+namespace InputReplay {
+
+struct RecordedEvent {
+    uint32_t frame;
+    sf::Event event;
+};
+
+struct FrameResult {
+    double cpuTime;         // In microseconds, from the frame's first event to it being presented
+    uint64_t drawCalls;
+    uint64_t vertices;
+    uint64_t textureUploads;
+};
+
+#pragma region serialization
+
+/**
+ * @brief Writes an event as a line of a recording
+ * @return Whether the event has been written (it's skipped if it's not one of the recorded types)
+ */
+inline bool writeEvent (FILE * file, uint32_t frame, const sf::Event & event) {
+    if (const auto * resized = event.getIf<sf::Event::Resized>())
+        fprintf(file, "%u Resized %u %u\n", frame, resized->size.x, resized->size.y);
+    else if (event.is<sf::Event::FocusGained>())
+        fprintf(file, "%u FocusGained\n", frame);
+    else if (event.is<sf::Event::FocusLost>())
+        fprintf(file, "%u FocusLost\n", frame);
+    else if (const auto * key = event.getIf<sf::Event::KeyPressed>())
+        fprintf(file, "%u KeyPressed %d %d %d %d %d %d\n", frame,
+            (int)key->code, (int)key->scancode, key->alt, key->control, key->shift, key->system);
+    else if (const auto * key = event.getIf<sf::Event::KeyReleased>())
+        fprintf(file, "%u KeyReleased %d %d %d %d %d %d\n", frame,
+            (int)key->code, (int)key->scancode, key->alt, key->control, key->shift, key->system);
+    else if (const auto * mouse = event.getIf<sf::Event::MouseButtonPressed>())
+        fprintf(file, "%u MouseButtonPressed %d %d %d\n", frame, (int)mouse->button, mouse->position.x, mouse->position.y);
+    else if (const auto * mouse = event.getIf<sf::Event::MouseButtonReleased>())
+        fprintf(file, "%u MouseButtonReleased %d %d %d\n", frame, (int)mouse->button, mouse->position.x, mouse->position.y);
+    else if (const auto * mouse = event.getIf<sf::Event::MouseMoved>())
+        fprintf(file, "%u MouseMoved %d %d\n", frame, mouse->position.x, mouse->position.y);
+    else if (const auto * wheel = event.getIf<sf::Event::MouseWheelScrolled>())
+        fprintf(file, "%u MouseWheelScrolled %d %a %d %d\n", frame,
+            (int)wheel->wheel, wheel->delta, wheel->position.x, wheel->position.y);
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @brief Parses a line of a recording
+ * @return The event, or nothing if the line is malformed
+ */
+inline std::optional<RecordedEvent> parseEvent (const char * line) {
+    uint32_t frame;
+    char name[32];
+    int offset;
+    if (sscanf(line, "%" SCNu32 " %31s%n", &frame, name, &offset) != 2) return std::nullopt;
+    const char * args = line + offset;
+
+    int a, b, c, d, e, f;
+    float delta;
+
+    if (!strcmp(name, "Resized") && sscanf(args, "%d %d", &a, &b) == 2)
+        return RecordedEvent{frame, sf::Event::Resized{{(unsigned)a, (unsigned)b}}};
+    if (!strcmp(name, "FocusGained"))
+        return RecordedEvent{frame, sf::Event::FocusGained{}};
+    if (!strcmp(name, "FocusLost"))
+        return RecordedEvent{frame, sf::Event::FocusLost{}};
+    if (!strcmp(name, "KeyPressed") && sscanf(args, "%d %d %d %d %d %d", &a, &b, &c, &d, &e, &f) == 6)
+        return RecordedEvent{frame, sf::Event::KeyPressed{
+            (sf::Keyboard::Key)a, (sf::Keyboard::Scancode)b, (bool)c, (bool)d, (bool)e, (bool)f}};
+    if (!strcmp(name, "KeyReleased") && sscanf(args, "%d %d %d %d %d %d", &a, &b, &c, &d, &e, &f) == 6)
+        return RecordedEvent{frame, sf::Event::KeyReleased{
+            (sf::Keyboard::Key)a, (sf::Keyboard::Scancode)b, (bool)c, (bool)d, (bool)e, (bool)f}};
+    if (!strcmp(name, "MouseButtonPressed") && sscanf(args, "%d %d %d", &a, &b, &c) == 3)
+        return RecordedEvent{frame, sf::Event::MouseButtonPressed{(sf::Mouse::Button)a, {b, c}}};
+    if (!strcmp(name, "MouseButtonReleased") && sscanf(args, "%d %d %d", &a, &b, &c) == 3)
+        return RecordedEvent{frame, sf::Event::MouseButtonReleased{(sf::Mouse::Button)a, {b, c}}};
+    if (!strcmp(name, "MouseMoved") && sscanf(args, "%d %d", &a, &b) == 2)
+        return RecordedEvent{frame, sf::Event::MouseMoved{{a, b}}};
+    if (!strcmp(name, "MouseWheelScrolled") && sscanf(args, "%d %a %d %d", &a, &delta, &b, &c) == 4)
+        return RecordedEvent{frame, sf::Event::MouseWheelScrolled{(sf::Mouse::Wheel)a, delta, {b, c}}};
+
+    return std::nullopt;
+}
+
+/**
+ * @brief Loads an entire recording
+ * @param path
+ * @param output Gets the events in order
+ * @return Whether the file could be read, malformed lines are skipped with a warning
+ */
+inline bool load (const char * path, std::vector<RecordedEvent> & output) {
+    FILE * file = fopen(path, "r");
+    if (file == nullptr) return false;
+
+    output.clear();
+    char line[256];
+    for (uint32_t lineNumber = 1; fgets(line, sizeof(line), file); lineNumber++) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        auto event = parseEvent(line);
+        if (event) output.push_back(*event);
+        else err("[InputReplay::load]: Skipping malformed line %u of %s\n", lineNumber, path);
+    }
+
+    fclose(file);
+    std::stable_sort(output.begin(), output.end(),
+        [](const RecordedEvent & a, const RecordedEvent & b){ return a.frame < b.frame; });
+    return true;
+}
+
+#pragma endregion
+#pragma region report
+
+/**
+ * @brief Prints the percentiles of the frame results, and writes every frame as CSV if csvPath is set
+ */
+inline void report (const std::vector<FrameResult> & frames, const char * csvPath = nullptr) {
+    if (frames.empty()) { printf("No frames replayed\n"); return; }
+
+    auto printPercentiles = [&](const char * name, auto member, const char * unit) {
+        std::vector<double> values;
+        for (auto & frame : frames) values.push_back((double)(frame.*member));
+        std::sort(values.begin(), values.end());
+        auto at = [&](double fraction) { return values[std::min((size_t)(fraction * values.size()), values.size() - 1)]; };
+        printf("%-16s p50 %10.1f  p95 %10.1f  p99 %10.1f  max %10.1f %s\n",
+            name, at(0.5), at(0.95), at(0.99), values.back(), unit);
+    };
+
+    printf("Replayed %zu frames\n", frames.size());
+    printPercentiles("CPU time",        &FrameResult::cpuTime,          "us");
+    printPercentiles("Draw calls",      &FrameResult::drawCalls,        "");
+    printPercentiles("Vertices",        &FrameResult::vertices,         "");
+    printPercentiles("Texture uploads", &FrameResult::textureUploads,   "");
+    fflush(stdout);
+
+    if (csvPath == nullptr) return;
+    FILE * file = fopen(csvPath, "w");
+    if (file == nullptr) { err("[InputReplay::report]: Could not write %s\n", csvPath); return; }
+    fprintf(file, "frame,cpu_us,draw_calls,vertices,texture_uploads\n");
+    for (size_t i = 0; i < frames.size(); i++)
+        fprintf(file, "%zu,%.3f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+            i, frames[i].cpuTime, frames[i].drawCalls, frames[i].vertices, frames[i].textureUploads);
+    fclose(file);
+}
+
+#pragma endregion
+
+}   // namespace InputReplay
+
+#endif  // __INPUT_REPLAY_INCLUDED__
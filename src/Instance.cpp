@@ -14,18 +14,31 @@
 #include <SFML/Window.hpp>
 #include <SFML/System.hpp>
 
+#include "JobSystem.cpp"
+#include "Profiler.cpp"
+#include "RenderStats.cpp"
 #include "RIFFLoader.cpp"
+#include "Log.cpp"
 
 #include "Instance.hpp"
 
 #include "Renderer/InstrumentRenderer.cpp"
 #include "Renderer/TrackerRenderer.cpp"
+#include "Renderer/RenderThread.cpp"
 
 const char * const filter[] = {"*.gczr"};
 
 constexpr uint16_t MOUSE_DOWN = 1;
 
-Instance::Instance() {
+constexpr unsigned int FRAMERATE_LIMIT = 60;
+// The rest stays queued for the next frame
+constexpr unsigned int INPUT_EVENT_BUDGET = 256;
+
+const char * const TRACE_FILENAME = "genecyzer-trace.json";
+
+Instance::Instance(const InstanceOptions & options) {
+    Log::start();
+
     // Init all variables
     selectionBounds.fill(-1);
     selectionInvertRect.fill(0);
@@ -38,107 +51,246 @@ Instance::Instance() {
 
     // Init graphics
     window.create(sf::VideoMode({200, 200}), "Genecyzer");
-    window.setFramerateLimit(60);
+    if (options.replayPath) {
+        // Still needed for its size, the frames go into offscreenTarget as fast as they can
+        window.setVisible(false);
+        offscreen = true;
+        replayPath = options.replayPath;
+    } else
+        window.setFramerateLimit(FRAMERATE_LIMIT);
+
+    if (options.recordPath) {
+        recordFile = fopen(options.recordPath, "w");
+        if (recordFile == nullptr) err("Could not open %s for recording\n", options.recordPath);
+        else fprintf(recordFile, "# Genecyzer input recording\n");
+    }
     InstrumentView = sf::View(sf::FloatRect({0.f, 0.f}, {200.f, 200.f}));
     TrackerView = sf::View(sf::FloatRect({0.f, 0.f}, {200.f, 200.f}));
 
-    if (openFileIntoProject()) saveProjectToFile();
-    else activeProject = Project::createDefault();
+    JobSystem::init();
+    JobSystem::setWakeCallback([this]{ requestRedraw(); });
+
+    // The window's context belongs to the render thread from now on
+    startRenderThread();
+
+    // Shown until the chosen file is loaded in the background,
+    // which then gets saved right back
+    activeProject = Project::createDefault();
+    // Recordings are always made and replayed on the default project
+    if (!options.recordPath && !options.replayPath)
+        openFileIntoProject([this]{ saveProjectToFile(); });
+}
+
+Instance::~Instance() {
+    stopRenderThread();
+    autosave.wait();    // Finishes writing it, shutdown() would cancel it if it hasn't started yet
+    JobSystem::shutdown();
+    if (recordFile) fclose(recordFile);
+    Log::stop();
 }
 
 void Instance::addMonospaceFont(const void * data, uint32_t size, std::vector<uint32_t> codepages){
+    std::lock_guard surfaces(surfaceMutex);
     font.init(data, size, codepages, 1);
 }
 
 void Instance::addMonospaceFont(const void * data, uint32_t size, const uint32_t * codepages, size_t codepagesSize){
+    std::lock_guard surfaces(surfaceMutex);
     font.init(data, size, codepages, codepagesSize, 1);
 }
 
-void Instance::ProcessEvents(){
+void Instance::beginFrame(){
 
     memset(&updateSections, 0, sizeof(updateSections));
 
     instrumentsToUpdate.clear();
 
-    while (const std::optional event = window.pollEvent())
-    {
+    // Results of background work, they set their own update flags
+    JobSystem::runContinuations();
 
-        if (event->is<sf::Event::Closed>())
-            window.close();
-        else if (event->is<sf::Event::Resized>()){
-            
-            //scale = std::max(static_cast<int>(std::ceil(event.size.height/(4*8*TILE_SIZE))), 1);
-            
-            updateSections.scale = 1;
+    // Only copies the project here, it's saved on a worker
+    autosave.update(activeProject, history.changes());
 
-            //int width = std::ceil((event.size.width/scale)/TILE_SIZE);
-
-
-        } else if (const auto* keyPressed = event->getIf<sf::Event::KeyPressed>()){
-            
-            if (keyPressed->scancode == sf::Keyboard::Scancode::Down)
-                eventHandleInstList (255, +1, 255, false);
-            else if (keyPressed->scancode == sf::Keyboard::Scancode::Up)
-                eventHandleInstList (0, -1, 0, true);
-            else if (keyPressed->scancode == sf::Keyboard::Scancode::Right)
-                eventHandleInstList (256-8, +8, 255, false);
-            else if (keyPressed->scancode == sf::Keyboard::Scancode::Left)
-                eventHandleInstList (7, -8, 0, true);
-            else if (keyPressed->scancode == sf::Keyboard::Scancode::E) {
-                singleTileTrackerRender = !singleTileTrackerRender;
-                updateSections.fullTrackerRerender = 1;
-            } else if (keyPressed->scancode == sf::Keyboard::Scancode::P) {
-                showPerformance = !showPerformance;
-                if (!showPerformance) {
-                    timePointDisplayData = "";
-                    interFrameUpdateSections.timepoints = true;
-                }
-            } else if (keyPressed->scancode == sf::Keyboard::Scancode::Equal && keyPressed->control) {
-                scale++;
-                updateSections.scale = 1;
-            } else if (keyPressed->scancode == sf::Keyboard::Scancode::Hyphen && keyPressed->control && scale > 1) {
-                scale--;
-                updateSections.scale = 1;
-            } else if (keyPressed->scancode == sf::Keyboard::Scancode::Apostrophe) {
-                lowerHalfMode ^= 1;
-                forceUpdateAll = 1;
-            }
-        } else if (const auto* mouseEvent = event->getIf<sf::Event::MouseButtonPressed>()) {
-            lastMousePress = *mouseEvent;
-            // do sumn for time
-            if (mouseEvent->button == sf::Mouse::Button::Left) mouseFlags |= MOUSE_DOWN;
-        } else if ( const auto* mouseMoveEvent = event->getIf<sf::Event::MouseMoved>()) {
-            //  || (const auto* touchMoveEvent = event->getIf<sf::Event::TouchMoved>())
-            if (mouseFlags & MOUSE_DOWN) {
-                // determine region
-                if (
-                    lowerHalfMode == 0 &&
-                    lastMousePress.position.y > scale*TILE_SIZE*(8+5) &&
-                    lastMousePress.position.x > scale*TILE_SIZE*(3+1)
-                ) {
-                    selectionBounds[0] = lastMousePress.position.x  / (scale*TILE_SIZE);
-                    selectionBounds[1] = lastMousePress.position.y  / (scale*TILE_SIZE);
-                    selectionBounds[2] = mouseMoveEvent->position.x / (scale*TILE_SIZE);
-                    selectionBounds[3] = mouseMoveEvent->position.y / (scale*TILE_SIZE);
-                    updateSections.tracker_selection = 1;
-                } else if (
-                    lowerHalfMode == 1 &&
-                    lastMousePress.position.y > scale*TILE_SIZE*8
-                ) {
-                    selectionBounds[0] = mouseMoveEvent->position.x;
-                    selectionBounds[1] = mouseMoveEvent->position.y;
-                }
+    loopFrame++;
+}
+
+void Instance::ProcessEvents(){
+
+    beginFrame();
+
+    auto handle = [this](const sf::Event & event) {
+        if (recordFile) InputReplay::writeEvent(recordFile, loopFrame, event);
+        handleEvent(event);
+    };
+
+    if (!framePending()) {
+        // Nothing to draw, sleep until something happens. While animating or
+        // while background work is in flight, wake up once per frame instead
+        int64_t timeout = animating() || !JobSystem::idle() ? 1000000 / FRAMERATE_LIMIT : 0;   // In microseconds, 0 waits forever
+        // Or until the autosave is due, if that's sooner
+        int64_t autosaveDue = autosave.timeUntilDue(history.changes());
+        if (autosaveDue >= 0 && (timeout == 0 || autosaveDue / 1000 < timeout))
+            timeout = std::max<int64_t>(autosaveDue / 1000, 1);
+        const std::optional event = window.waitEvent(sf::microseconds(timeout));
+        if (event) handle(*event);
+    }
+
+    for (unsigned int handled = 0; handled < INPUT_EVENT_BUDGET; handled++) {
+        const std::optional event = window.pollEvent();
+        if (!event) break;
+        handle(*event);
+    }
+
+    applyFrameInput();
+}
+
+bool Instance::framePending() const {
+    static const decltype(updateSections) noUpdates {};
+    return
+        forceUpdateAll ||
+        redrawRequested ||
+        memcmp(&updateSections, &noUpdates, sizeof(updateSections));
+}
+
+bool Instance::animating() const {
+    return showPerformance || interFrameUpdateSections.timepoints;
+}
+
+void Instance::handleEvent(const sf::Event & event){
+    if (event.is<sf::Event::Closed>()) {
+        stopRenderThread();
+        window.close();
+    }
+    else if (event.is<sf::Event::Resized>()){
+        
+        //scale = std::max(static_cast<int>(std::ceil(event.size.height/(4*8*TILE_SIZE))), 1);
+        
+        updateSections.scale = 1;
+
+        //int width = std::ceil((event.size.width/scale)/TILE_SIZE);
+
+    } else if (event.is<sf::Event::FocusGained>()) {
+        updateSections.redraw = 1;
+
+
+    } else if (const auto* keyPressed = event.getIf<sf::Event::KeyPressed>()){
+        
+        if (keyPressed->scancode == sf::Keyboard::Scancode::Down)
+            eventHandleInstList (255, +1, 255, false);
+        else if (keyPressed->scancode == sf::Keyboard::Scancode::Up)
+            eventHandleInstList (0, -1, 0, true);
+        else if (keyPressed->scancode == sf::Keyboard::Scancode::Right)
+            eventHandleInstList (256-8, +8, 255, false);
+        else if (keyPressed->scancode == sf::Keyboard::Scancode::Left)
+            eventHandleInstList (7, -8, 0, true);
+        else if (keyPressed->scancode == sf::Keyboard::Scancode::E) {
+            singleTileTrackerRender = !singleTileTrackerRender;
+            updateSections.fullTrackerRerender = 1;
+        } else if (keyPressed->scancode == sf::Keyboard::Scancode::P && keyPressed->shift) {
+            if (Profiler::exportChromeTrace(TRACE_FILENAME))
+                LOG_INFO("Profiler trace written to %s\n", TRACE_FILENAME);
+            else
+                err("Could not write the profiler trace to %s\n", TRACE_FILENAME);
+        } else if (keyPressed->scancode == sf::Keyboard::Scancode::P) {
+            showPerformance = !showPerformance;
+            if (!showPerformance) {
+                timePointDisplayData = "";
+                interFrameUpdateSections.timepoints = true;
             }
-        } else if (const auto* mouseEvent = event->getIf<sf::Event::MouseButtonReleased>()) {
-            if (mouseEvent->button == sf::Mouse::Button::Left) mouseFlags &= ~MOUSE_DOWN;
+        } else if (keyPressed->scancode == sf::Keyboard::Scancode::Equal && keyPressed->control) {
+            scale++;
+            updateSections.scale = 1;
+        } else if (keyPressed->scancode == sf::Keyboard::Scancode::Hyphen && keyPressed->control && scale > 1) {
+            scale--;
+            updateSections.scale = 1;
+        } else if (
+            (keyPressed->scancode == sf::Keyboard::Scancode::Z && keyPressed->control && keyPressed->shift) ||
+            (keyPressed->scancode == sf::Keyboard::Scancode::Y && keyPressed->control)
+        ) {
+            if (history.redo(activeProject)) updateSections.fullTrackerRerender = 1;
+        } else if (keyPressed->scancode == sf::Keyboard::Scancode::Z && keyPressed->control) {
+            if (history.undo(activeProject)) updateSections.fullTrackerRerender = 1;
+        } else if (keyPressed->scancode == sf::Keyboard::Scancode::Apostrophe) {
+            lowerHalfMode ^= 1;
+            forceUpdateAll = 1;
         }
+    } else if (const auto* mouseEvent = event.getIf<sf::Event::MouseButtonPressed>()) {
+        applyPendingMouseMove();    // The drag so far still belongs to the previous press
+        lastMousePress = *mouseEvent;
+        history.breakCoalescing();      // Clicking somewhere else ends a typing burst
+        // do sumn for time
+        if (mouseEvent->button == sf::Mouse::Button::Left) mouseFlags |= MOUSE_DOWN;
+    } else if ( const auto* mouseMoveEvent = event.getIf<sf::Event::MouseMoved>()) {
+        //  || (const auto* touchMoveEvent = event.getIf<sf::Event::TouchMoved>())
+        if (mouseFlags & MOUSE_DOWN)
+            frameInput.mouseMove = mouseMoveEvent->position;
+    } else if (const auto* mouseEvent = event.getIf<sf::Event::MouseButtonReleased>()) {
+        applyPendingMouseMove();
+        if (mouseEvent->button == sf::Mouse::Button::Left) mouseFlags &= ~MOUSE_DOWN;
+    } else if (const auto* scrollEvent = event.getIf<sf::Event::MouseWheelScrolled>()) {
+        if (
+            scrollEvent->wheel == sf::Mouse::Wheel::Vertical &&
+            scrollEvent->position.y < scale*TILE_SIZE*INST_ENTRIES_PER_COLUMN
+        )
+            frameInput.scroll += scrollEvent->delta;
     }
 }
 
+void Instance::applyPendingMouseMove(){
+    if (!frameInput.mouseMove) return;
+    auto position = *frameInput.mouseMove;
+    frameInput.mouseMove.reset();
+
+    // determine region
+    if (
+        lowerHalfMode == 0 &&
+        lastMousePress.position.y > scale*TILE_SIZE*(8+5) &&
+        lastMousePress.position.x > scale*TILE_SIZE*(3+1)
+    ) {
+        selectionBounds[0] = lastMousePress.position.x  / (scale*TILE_SIZE);
+        selectionBounds[1] = lastMousePress.position.y  / (scale*TILE_SIZE);
+        selectionBounds[2] = position.x / (scale*TILE_SIZE);
+        selectionBounds[3] = position.y / (scale*TILE_SIZE);
+        updateSections.tracker_selection = 1;
+    } else if (
+        lowerHalfMode == 1 &&
+        lastMousePress.position.y > scale*TILE_SIZE*8
+    ) {
+        selectionBounds[0] = position.x;
+        selectionBounds[1] = position.y;
+        updateSections.redraw = 1;
+    }
+}
+
+void Instance::applyFrameInput(){
+    applyPendingMouseMove();
+
+    // Every whole notch moves the instrument selection by one,
+    // touchpads send fractions of them
+    int notches = frameInput.scroll;
+    frameInput.scroll -= notches;
+    for (; notches > 0; notches--)
+        eventHandleInstList (0, -1, 0, true);
+    for (; notches < 0; notches++)
+        eventHandleInstList (255, +1, 255, false);
+
+    // Held keys only rerender the two entries, however many repeats came in
+    if (frameInput.instSelected >= 0 && frameInput.instSelected != instSelected) {
+        instrumentsToUpdate.push_back(frameInput.instSelected);
+        instrumentsToUpdate.push_back(instSelected);
+        instSelected = frameInput.instSelected;
+        updateSections.inst_pos = 1;
+    }
+    frameInput.instSelected = -1;
+}
+
 void Instance::Update(){
 
-    auto updStart = clock.getElapsedTime();
-    appendTimepoint();
+    // Skip the frame entirely if nothing has been damaged
+    if (!framePending() && !animating()) return;
+    redrawRequested = false;
+
+    PROFILE_SCOPE("Instance::Update");
         
     #pragma region ConditionalUpdates
 
@@ -148,33 +300,48 @@ void Instance::Update(){
         forceUpdateAll = 0;
     }
 
-    if (updateSections.inst_pos)
-        renderInstList();
+    // Takes the surface lock by itself, only for the part touching the GPU
+    if (lowerHalfMode == 0 && updateSections.fullTrackerRerender)
+        fullRerenderTracker();
+
+    {
+        std::lock_guard surfaces(surfaceMutex);
+
+        if (updateSections.inst_pos)
+            renderInstList();
+
+        if (interFrameUpdateSections.timepoints) {
+            renderTimepoints();
+            interFrameUpdateSections.timepoints = false;
+        }
+
+        if (lowerHalfMode == 0) {
+            if (updateSections.fullTrackerRerender || updateSections.tracker) {
+                if (renderBeatsTexture())
+                    updateBeatsSprite();
+            }
+            if (updateSections.tracker_selection)
+                updateTrackerSelection();
+        }
+
+        displaySurfaces();
+    }
 
     if (updateSections.inst_pos || updateSections.scale)   
         updateInstPage();
 
-    if (interFrameUpdateSections.timepoints) {
-        renderTimepoints();
-        interFrameUpdateSections.timepoints = false;
-    }
-        
     switch (lowerHalfMode) {
         case 0:
-            if (updateSections.fullTrackerRerender)
-                fullRerenderTracker();
-            if (updateSections.fullTrackerRerender || updateSections.tracker || updateSections.scale){
+            if (updateSections.fullTrackerRerender || updateSections.tracker || updateSections.scale)
                 updateTrackerPos();
-                renderBeatsTexture();
-                updateBeatsSprite();
-            }
-            if (updateSections.tracker_selection)
-                updateTrackerSelection();
             break;
 
         case 1:
             if (updateSections.scale)
                 updateTrackerPos();
+            bezierTest.updatePosition(std::array<sf::Vector2f, 2> 
+            {sf::Vector2f((float)selectionBounds[0] / scale, (float)selectionBounds[1] / scale - 8*TILE_SIZE), {100, 100}});
+            bezierTest.calculate((float)scale/16, 3.f/scale, false);
             break;
 
     }
@@ -182,101 +349,137 @@ void Instance::Update(){
     #pragma endregion
     #pragma region AlwaysUpdates
 
-    appendTimepoint();
-    window.clear(sf::Color(255,255,0,0));
+    // The drawing itself happens on the render thread, see Renderer/RenderThread.cpp
+    publishFrame();
 
-    appendTimepoint();
-    window.setView(InstrumentView);
-    window.draw(instrumentSprite);
+    // Replays close the frame themselves once it's been presented
+    if (!offscreen) endFrame();
 
-    appendTimepoint();
-    window.setView(TrackerView);
+    #pragma endregion
 
-    switch (lowerHalfMode) {
-        case 0: {
-            window.draw(trackerMatrix);
-            window.draw(beatsSprite);
-            break;
-        }
+}
 
-        case 1: {
-            // auto start = std::chrono::high_resolution_clock::now();
-            bezierTest.updatePosition(std::array<sf::Vector2f, 2> 
-            {sf::Vector2f((float)selectionBounds[0] / scale, (float)selectionBounds[1] / scale - 8*TILE_SIZE), {100, 100}});
-            bezierTest.calculate((float)scale/16, 3.f/scale, false);
-            // auto elapsed = std::chrono::high_resolution_clock::now() - start;
-            // uint64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>( elapsed).count();
-            // printf("Elapsed: %08lu \n", microseconds); fflush(stdout);
-            window.draw(bezierTest);
-            break;
-        }
+void Instance::endFrame(){
+    RenderStats::frame();
+    JobSystem::frame();
+    Profiler::frame();
+
+    if (showPerformance) {
+        auto frame = Profiler::frameStats();
+        auto uiStats = RenderStats::lastFrame();
+        auto presentedStats = RenderStats::lastPresented();
+        timePointDisplayData = std::format("FPS: {:2.2f} | Frame p50/p99: {:.0f}/{:.0f}us",
+            frame.p50 > 0 ? 1000000 / frame.p50 : 0, frame.p50, frame.p99);
+        timePointDisplayData += std::format(" | Draws: {} ({} verts, {} target switches), caching {} | Uploads: {} ({} B)",
+            presentedStats.drawCalls, presentedStats.vertices, presentedStats.targetSwitches,
+            uiStats.drawCalls, uiStats.textureUploads, uiStats.uploadedBytes);
+        size_t patternRows;
+        size_t patternBytes = activeProject.song(currentSong).patternMemoryUsage(patternRows);
+        auto pool = PatternPool::stats();
+        timePointDisplayData += std::format(" | Patterns: {} B per 10k rows, {}/{} interned shared",
+            patternRows ? patternBytes * 10000 / patternRows : 0, pool.hits, pool.lookups);
+        timePointDisplayData += std::format(" | Undo: {}/{} ({} B)",
+            history.undoDepth(), history.redoDepth(), history.memoryUsage());
+        auto & saved = autosave.stats();
+        timePointDisplayData += std::format(" | Autosave: {} ({}snapshot {}us, save {}ms)",
+            saved.saves, saved.failed ? "failed, " : "", saved.snapshotTime / 1000, saved.saveTime / 1000000);
+        auto & workers = JobSystem::workerStats();
+        for (size_t i = 0; i < workers.size(); i++)
+            timePointDisplayData += std::format(" | Worker {}: {:.0f}% ({} jobs)", i, workers[i].utilization * 100, workers[i].jobs);
+        for (auto & scope : Profiler::scopeStats())
+            timePointDisplayData += std::format(" | {}: {:.0f}/{:.0f}", scope.name, scope.p50, scope.p99);
+        interFrameUpdateSections.timepoints = true;
     }
+}
 
-    // 24, 36, 54
+void Instance::eventHandleInstList (int limit, int modifier, uint8_t replacement, bool more){
+    // Only moves the pending selection, see applyFrameInput()
+    int & selected = frameInput.instSelected;
+    if (selected < 0) selected = instSelected;
 
-    // auto selection = sf::RectangleShape(
-    //     sf::Vector2f((selectionBounds[2] - selectionBounds[0])*TILE_SIZE, 
-    //     (selectionBounds[3] - selectionBounds[1])*TILE_SIZE));
-    // selection.setPosition(selectionBounds[0]*TILE_SIZE, 
-    //     (selectionBounds[1]-8)*TILE_SIZE);
-    // selection.setFillColor(sf::Color(128, 128, 255, 80));
-    // window.draw(selection);
+    if ((!more && selected < limit) || (more && selected > limit))
+        selected += modifier;
+    else
+        selected = replacement;
+}
+
+#pragma region InputReplay
 
-    // tiles.render(0,0,&window, font[0]);
-    // window.draw(tile.renderVertex, sf::RenderStates(&font[0]));
-    // window.draw(tile1.renderVertex, sf::RenderStates(&font[0]));
-    // window.draw(tile2.renderVertex, sf::RenderStates(&font[0]));
-    // window.draw(tile3.renderVertex, sf::RenderStates(&font[0]));
-    // window.setView(TrackerView);
-    
-    appendTimepoint();
+int Instance::runReplay(const char * csvPath){
+    std::vector<InputReplay::RecordedEvent> events;
+    if (replayPath == nullptr || !InputReplay::load(replayPath, events)) {
+        err("Could not load the recording %s\n", replayPath ? replayPath : "(none)");
+        return 1;
+    }
 
-    window.display();
+    std::vector<InputReplay::FrameResult> results;
+    uint32_t lastFrame = events.empty() ? 0 : events.back().frame;
+    size_t next = 0;
 
-    appendTimepoint();
-    clock.restart();
+    // Recorded frames are numbered from 1, as loopFrame is incremented before handling anything
+    while (loopFrame < lastFrame) {
+        int64_t start = Profiler::now();
+        beginFrame();
 
-    if (showPerformance) {
-        timePointDisplayData = std::format("FPS: {:2.2f} | Total: {:6d} | Update time: {:6d} | Time points: ",
-            (double)1000000 / timepoints.back(),
-            timepoints.back(),
-            timepoints.back() - updStart.asMicroseconds());
-        for (int i = 1; i < timepoints.size(); i++) {
-            timePointDisplayData += std::format("{:6d} ", timepoints[i] - timepoints[i-1]);
+        for (; next < events.size() && events[next].frame <= loopFrame; next++) {
+            // The hidden window has to follow, the views are calculated from its size
+            if (const auto * resized = events[next].event.getIf<sf::Event::Resized>())
+                window.setSize(resized->size);
+            handleEvent(events[next].event);
         }
-        interFrameUpdateSections.timepoints = true;
-        timepoints.clear();
+        applyFrameInput();
+
+        uint64_t published = publishedFrames;
+        Update();
+        if (publishedFrames == published) continue;     // Nothing damaged, nothing to measure
+
+        waitForPresent();
+        endFrame();
+
+        // In lockstep here, so the UI frame and the one presented after it add up to the whole frame
+        auto stats = RenderStats::lastFrame() + RenderStats::lastPresented();
+        results.push_back(InputReplay::FrameResult {
+            (Profiler::now() - start) / 1000.0, stats.drawCalls, stats.vertices, stats.textureUploads
+        });
     }
-    #pragma endregion
 
+    stopRenderThread();
+    InputReplay::report(results, csvPath);
+    return 0;
 }
 
-void Instance::eventHandleInstList (int limit, int modifier, uint8_t replacement, bool more){
-    if ((!more && instSelected < limit) || (more && instSelected > limit))
-        instrumentsToUpdate.push_back(instSelected + modifier);
-    else
-        instrumentsToUpdate.push_back(replacement);
-    
-    if (instrumentsToUpdate.back() != instSelected){
-        instrumentsToUpdate.push_back(instSelected);
-        instSelected = instrumentsToUpdate[instrumentsToUpdate.size()-2] & 0xFF;
-        updateSections.inst_pos = 1;
-    } else
-        instrumentsToUpdate.pop_back();
-}
+#pragma endregion
 
 #pragma region fileOps
 
-bool Instance::openFileIntoProject () {
+bool Instance::openFileIntoProject (std::function<void()> onLoaded) {
     auto filenamePtr = tinyfd_openFileDialog("Open a Genecyzer project file", NULL, 1, filter, "Genecyzer project file", 0);
     if (filenamePtr == NULL) {
         return false;
     }
     std::string filename(filenamePtr);
-    auto data = std::ifstream(filename, std::ios_base::binary | std::ios_base::in);
-    auto file = RIFF::RIFFReader();
-    file.open(data);
-    RIFFLoader::loadRIFFFile(file, activeProject);
+
+    if (projectLoad) projectLoad->cancel();
+    projectLoad = JobSystem::createGroup();
+
+    auto project = std::make_shared<Project>();
+    JobSystem::submit(projectLoad, [filename, project](const JobSystem::TaskGroup &){
+        project->Load(filename.c_str());
+    });
+
+    JobSystem::then(projectLoad, [this, group = projectLoad, project, onLoaded]{
+        if (group->isCancelled()) return;
+        if (project->songs.empty()) {
+            err("The loaded project has no songs, keeping the current one\n");
+            return;
+        }
+
+        activeProject = std::move(*project);
+        history.clear();
+        currentSong = 0;
+        forceUpdateAll = 1;
+        if (onLoaded) onLoaded();
+    });
 
     return true;
 }
@@ -288,25 +491,17 @@ bool Instance::saveProjectToFile () {
     }
 
     std::string outFilename(outFilenamePtr);
+    // The songs not loaded yet are copied from the file they were loaded from, which might be this one.
+    // An autosave in progress shares that mapping and may still be reading from it, so let it finish first
+    autosave.wait();
+    activeProject.loadAllSongs();
     auto outData = std::ofstream(outFilename, std::ios_base::out | std::ios_base::binary);
-    RIFF::RIFFWriter writer;
-
-    writer.open(outData);
-
-    // saveInternal(writer);
-    RIFFLoader::saveRIFFFile(writer, activeProject);
-    writer.close();
+    activeProject.Save(outData);
     outData.close();
 
     return true;
 }
 
-inline void Instance::appendTimepoint() {
-    if (showPerformance) {
-        timepoints.push_back(clock.getElapsedTime().asMicroseconds());
-    }
-}
-
 #pragma endregion
 
 #endif // __INSTANCE_CPP_INCLUDED__
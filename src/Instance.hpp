@@ -4,7 +4,13 @@
 #include <SFML/Graphics.hpp>
 
 #include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <vector>
 
 #include "ChrFont.cpp"
@@ -12,6 +18,10 @@
 #include "Project.cpp"
 #include "ModularSynth.cpp"
 #include "CachedTile.cpp"
+#include "JobSystem.cpp"
+#include "InputReplay.cpp"
+#include "UndoHistory.cpp"
+#include "Autosave.cpp"
 
 constexpr unsigned int MAX_INST_COUNT = 256;
 constexpr unsigned int INST_ENTRY_WIDTH = 16;
@@ -19,21 +29,41 @@ constexpr unsigned int INST_ENTRIES_PER_COLUMN = 8;
 constexpr unsigned int INST_COLUMNS = MAX_INST_COUNT / INST_ENTRIES_PER_COLUMN;
 constexpr unsigned int INST_WIDTH = INST_COLUMNS * INST_ENTRY_WIDTH;
 
+struct InstanceOptions {
+    const char * recordPath = nullptr;  // Write every handled event into this file
+    const char * replayPath = nullptr;  // Replay this recording into a hidden window and an offscreen target
+};
+
 class Instance {
 
     public:
-        Instance();
+        Instance(const InstanceOptions & options = {});
+        ~Instance();
         void ProcessEvents();
         void Update();
 
+        // Replays the whole recording given in the options, then prints the report
+        int runReplay(const char * csvPath = nullptr);
+
         void addMonospaceFont(const void * data, uint32_t size, std::vector<uint32_t> codepages);
         void addMonospaceFont(const void * data, uint32_t size, const uint32_t * codepages, size_t codepagesSize);
 
         bool isWindowOpen(){ return window.isOpen(); };
 
+        // Thread-safe, forces at least one more frame to be drawn
+        void requestRedraw(){ redrawRequested = true; };
+
 
     protected:
+        void beginFrame();
+        void endFrame();
+        void handleEvent(const sf::Event & event);
+        bool framePending() const;
+        bool animating() const;
+
         void eventHandleInstList (int, int, uint8_t, bool);
+        void applyPendingMouseMove();
+        void applyFrameInput();
         void renderInstList();
 
         void fullRerenderTracker();
@@ -42,13 +72,19 @@ class Instance {
         void updateTrackerPos();
         void updateTrackerSelection();
 
-        void renderBeatsTexture();
+        bool renderBeatsTexture();
         void updateBeatsSprite();
 
-        inline void appendTimepoint();
         void renderTimepoints();
 
-        bool openFileIntoProject();
+        void startRenderThread();
+        void stopRenderThread();
+        void publishFrame();
+        void displaySurfaces();
+        void waitForPresent();
+        void renderLoop();
+
+        bool openFileIntoProject(std::function<void()> onLoaded = nullptr);
         bool saveProjectToFile();
 
         bool saveSongToSNESFMData();
@@ -77,15 +113,21 @@ class Instance {
 
         bool showPerformance = false;
 
-        sf::Texture instrumentTexture;
-        sf::Sprite instrumentSprite {instrumentTexture};
+        AutoCachedTileMatrix instrumentMatrix;
         sf::View InstrumentView;
 
         AutoCachedTileMatrix trackerMatrix;
         sf::View TrackerView;
         
-        sf::Texture beatsTexture;
-        sf::RectangleShape beatsSprite;
+        sf::Texture beatsTexture;           // 1 pixel wide, 1 pixel per row
+        sf::VertexArray beatsSprite {sf::PrimitiveType::Triangles};
+
+        std::vector<uint16_t> trackerSeparatorColumns;
+        struct {
+            std::vector<uint16_t> beats_major;
+            std::vector<uint16_t> beats_minor;
+            size_t rows = 0;
+        } beatsCache;
 
         #pragma region Update
         bool forceUpdateAll = 0;
@@ -97,12 +139,23 @@ class Instance {
             bool inst_list;
             bool tracker;
             bool tracker_selection;
+            bool redraw;    // Nothing to rerender, but the frame has changed
         } updateSections;
 
         struct {
             bool timepoints;
         } interFrameUpdateSections;
 
+        std::atomic<bool> redrawRequested = false;
+
+        // Collected over all of the frame's events and applied once in
+        // applyFrameInput(), so the view work doesn't scale with their amount
+        struct {
+            std::optional<sf::Vector2i> mouseMove;  // Latest position while dragging
+            float scroll = 0;                       // Accumulated vertical wheel delta, the fraction carries over
+            int instSelected = -1;                  // Where the arrow keys have moved the selection to, -1 if untouched
+        } frameInput;
+
         std::vector<uint8_t> instrumentsToUpdate;
         std::array<int, 4> selectionBounds;
         std::array<uint16_t, 4> selectionInvertRect;
@@ -110,11 +163,53 @@ class Instance {
 
         sf::RenderWindow window;
 
+        #pragma region RenderThread
+        // Everything the render thread needs to draw a frame, besides the
+        // tile surfaces. Written by the UI thread into the back slot only
+        struct FrameState {
+            sf::View instrumentView;
+            sf::View trackerView;
+            sf::Vector2u size;      // Of the window, the offscreen target follows it
+            uint8_t lowerHalfMode = 0;
+            sf::VertexArray beats;
+            ModSynthBezier bezier;
+            int64_t published = 0;  // Profiler::now() at the time of publishing
+            uint64_t number = 0;    // What publishedFrames becomes by publishing it
+        };
+
+        std::array<FrameState, 2> frameStates;
+        uint8_t frontFrame = 0;
+        bool frameFresh = false;
+        bool renderThreadRunning = false;
+        uint64_t publishedFrames = 0, presentedFrames = 0;
+        std::mutex frameMutex;                  // Guards everything above
+        std::condition_variable frameCondition;
+        std::thread renderThread;
+
+        // Held by the UI thread while touching the GL side of instrumentMatrix,
+        // trackerMatrix, beatsTexture or the font, and by the render thread
+        // while drawing them (but not while waiting in display()). The UI thread
+        // calls displaySurfaces() before releasing it, see RenderThread.cpp
+        std::mutex surfaceMutex;
+
+        bool offscreen = false;                 // Replaying, draws into offscreenTarget instead of the window
+        sf::RenderTexture offscreenTarget;
+        #pragma endregion
+
+        #pragma region InputReplay
+        const char * replayPath = nullptr;
+        FILE * recordFile = nullptr;
+        uint32_t loopFrame = 0;                 // Main loop iterations so far, recorded with every event
+        #pragma endregion
+
         sf::VideoMode maxResolutionVideoMode;
 
         ChrFont font;
 
         Project activeProject;
+        UndoHistory history;            // Of activeProject, cleared when another one is opened
+        Autosave autosave;              // Of activeProject, whenever history has changes
+        JobSystem::Group projectLoad;   // Cancelled if another file gets opened before it's done
 
         uint16_t mouseFlags = 0;
 
@@ -122,8 +217,6 @@ class Instance {
 
         ModSynthBezier bezierTest;
 
-        sf::Clock clock;
-        std::vector<std::int64_t> timepoints;
         std::string timePointDisplayData;
 };
 
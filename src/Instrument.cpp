@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "Utils.cpp"
+#include "TextRenderer.cpp"
 
 #pragma region classDefinitions
 
@@ -29,7 +30,13 @@ class Instrument {
 
         void setName(std::string);
         void setName(std::u32string);
-        std::string getName() const;
+        const std::string & getName() const;
+
+        /**
+         * @brief Get the name laid out as tiles of the font, one per character, padded with spaces
+         * @note Cached until the name or the font changes, only call from the UI thread
+         */
+        const std::array<uint32_t, INSTRUMENT_NAME_LENGTH> & getNameTiles(const ChrFont & font) const;
 
         void setPalette(uint8_t palette);
         uint8_t getPalette() const;
@@ -38,6 +45,11 @@ class Instrument {
         std::array<uint32_t, INSTRUMENT_NAME_LENGTH> name;
         uint8_t palette;
 
+        // Derived from name, so the instrument list doesn't have to transcode or lay out text
+        std::string nameUTF8;
+        mutable std::array<uint32_t, INSTRUMENT_NAME_LENGTH> nameTiles;
+        mutable uint64_t nameTilesGeneration = 0;   // The generation of the font nameTiles is for, 0 if outdated
+
         std::array<Macro, 5> macros;
 
 };
@@ -47,6 +59,7 @@ class Instrument {
 
 Instrument::Instrument(){
     name.fill(' ');
+    nameUTF8.assign(INSTRUMENT_NAME_LENGTH, ' ');
     this->palette = 7;
 }
 
@@ -57,17 +70,28 @@ void Instrument::setName(std::string name){
 
 void Instrument::setName(std::u32string name){
     std::copy_n(name.data(), std::min((size_t)INSTRUMENT_NAME_LENGTH, name.size()), this->name.begin());
+    nameUTF8 = To_UTF8(std::u32string(this->name.begin(), this->name.end()));
+    nameTilesGeneration = 0;
 }
 
-std::string Instrument::getName() const{
-    std::u32string UTF32_name;
-    for (int i = 0; i < INSTRUMENT_NAME_LENGTH; i++){
-        // printf("%04x ", this->name[i]);
-        UTF32_name += this->name[i];
+const std::string & Instrument::getName() const{
+    return nameUTF8;
+}
+
+const std::array<uint32_t, INSTRUMENT_NAME_LENGTH> & Instrument::getNameTiles(const ChrFont & font) const{
+    if (font.generation && nameTilesGeneration == font.generation) return nameTiles;
+
+    // Same glyphs as the first line of TextRenderer::render
+    std::u32string preprocessed = TextRenderer::preprocess(std::u32string(name.begin(), name.end()));
+    size_t length = 0;
+    for (char32_t character : preprocessed) {
+        if (character == 0 || character == 0x0A || length == INSTRUMENT_NAME_LENGTH) break;
+        if (character == 0x200B || character == 0x2060) continue;   // ZWSP, ZWNBSP
+        nameTiles[length++] = TextRenderer::glyph(character == 0xA0 ? 0x20 : character, font);
     }
-    // printf("\n"); fflush(stdout);
-    std::string output = To_UTF8(UTF32_name);
-    return output;
+    std::fill(nameTiles.begin() + length, nameTiles.end(), 0x20);
+    nameTilesGeneration = font.generation;
+    return nameTiles;
 }
 
 void Instrument::setPalette(uint8_t palette){
@@ -0,0 +1,408 @@
+#ifndef __JOB_SYSTEM_INCLUDED__
+#define __JOB_SYSTEM_INCLUDED__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Profiler.cpp"
+
+// Work-stealing job system:
+
+/*  Usage:
+        auto group = JobSystem::createGroup();
+        JobSystem::submit(group, [](const JobSystem::TaskGroup & group){
+            ...     // Check group.isCancelled() every now and then if long
+        });
+        JobSystem::then(group, []{ ... });
+    Every worker has its own deque of jobs: it pushes and
+    pops its own jobs at the back and, once it runs out,
+    steals from the front of the others'. Jobs submitted
+    from outside the workers are spread round-robin.
+
+    A group's continuation runs on the UI thread, from
+    JobSystem::runContinuations(), once all of its jobs are
+    done, so it can safely touch the project and the update
+    flags. Cancelling a group skips its jobs that have not
+    started yet, the continuation still runs (and can check
+    isCancelled() to throw its results away).
+
+    TaskGroup::wait() runs the group's own queued jobs on the
+    waiting thread, so the UI thread can fan work out and
+    help with it, then blocks until the ones already running
+    elsewhere are done. It never picks up other groups' jobs,
+    which could take far longer than the frame has.
+*/
+
+namespace JobSystem {
+
+class TaskGroup;
+using Group = std::shared_ptr<TaskGroup>;
+using Job = std::function<void(const TaskGroup &)>;
+
+namespace internal { inline void finish (TaskGroup & group); }
+
+struct WorkerStats {
+    uint64_t jobs;          // Jobs finished since the previous JobSystem::frame()
+    double utilization;     // Fraction of the time since the previous JobSystem::frame() spent running jobs
+};
+
+class TaskGroup {
+    public:
+        void cancel () { cancelled.store(true, std::memory_order_relaxed); };
+        bool isCancelled () const { return cancelled.load(std::memory_order_relaxed); };
+        bool isDone () const { return pending.load(std::memory_order_acquire) == 0; };
+
+        /**
+         * @brief Waits for every job of the group to finish, running its queued jobs in the meantime
+         * @note Never call this from a job of the same group. Once it returns, the continuation
+         * (if any) is queued for runContinuations()
+         */
+        void wait ();
+
+    private:
+        friend void submit (const Group & group, Job job);
+        friend void then (const Group & group, std::function<void()> continuation);
+        friend void internal::finish (TaskGroup & group);
+
+        std::atomic<uint32_t> pending {0};
+        std::atomic<uint32_t> unsettled {0};    // Like pending, but only drops once the continuation is queued
+        std::atomic<bool> cancelled {false};
+        std::mutex continuationMutex;
+        std::function<void()> continuation;
+};
+
+#pragma region internal
+
+namespace internal {
+
+    struct Task {
+        Job job;
+        Group group;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;     // Owner works at the back, thieves at the front
+        std::thread thread;
+
+        std::atomic<int64_t> busyTime {0};
+        std::atomic<uint64_t> jobs {0};
+        int64_t lastBusyTime = 0;   // Only touched by JobSystem::frame()
+        uint64_t lastJobs = 0;
+        std::string counterName;    // Has to outlive the profiler's trace
+    };
+
+    inline std::vector<std::unique_ptr<Worker>> workers;
+    inline std::atomic<bool> running = false;
+    inline std::atomic<uint64_t> queued = 0;
+    inline std::atomic<uint64_t> unfinished = 0;    // Submitted jobs not done yet, queued or running
+    inline std::atomic<uint32_t> nextWorker = 0;
+    inline std::mutex sleepMutex;
+    inline std::condition_variable sleepCondition;
+    inline std::mutex doneMutex;
+    inline std::condition_variable doneCondition;   // Notified whenever a group's last job finishes
+
+    inline thread_local int32_t currentWorker = -1;
+
+    inline std::mutex continuationsMutex;
+    inline std::vector<std::function<void()>> continuations;
+    inline std::function<void()> wakeCallback;
+
+    // Only accessed from the thread calling JobSystem::frame()
+    inline std::vector<WorkerStats> stats;
+    inline int64_t lastFrame = -1;
+
+    inline void push (Task && task) {
+        uint32_t index = currentWorker >= 0
+            ? currentWorker
+            : nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+        {
+            std::lock_guard lock(workers[index]->mutex);
+            workers[index]->tasks.push_back(std::move(task));
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard lock(sleepMutex);   // So that a worker about to sleep can't miss it
+        }
+        sleepCondition.notify_one();
+    }
+
+    inline bool take (Task & output) {
+        if (queued.load(std::memory_order_acquire) == 0) return false;
+
+        size_t count = workers.size();
+        size_t self = currentWorker >= 0 ? currentWorker : 0;
+        for (size_t i = 0; i < count; i++) {
+            auto & worker = *workers[(self + i) % count];
+            std::lock_guard lock(worker.mutex);
+            if (worker.tasks.empty()) continue;
+            if (i == 0 && currentWorker >= 0) {
+                output = std::move(worker.tasks.back());
+                worker.tasks.pop_back();
+            } else {
+                output = std::move(worker.tasks.front());
+                worker.tasks.pop_front();
+            }
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // Takes a queued job of the given group only, from wherever it is
+    inline bool take (Task & output, const TaskGroup * group) {
+        if (queued.load(std::memory_order_acquire) == 0) return false;
+
+        for (auto & worker : workers) {
+            std::lock_guard lock(worker->mutex);
+            auto task = std::find_if(worker->tasks.begin(), worker->tasks.end(),
+                [group](const Task & task){ return task.group.get() == group; });
+            if (task == worker->tasks.end()) continue;
+            output = std::move(*task);
+            worker->tasks.erase(task);
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    inline void post (std::function<void()> continuation) {
+        {
+            std::lock_guard lock(continuationsMutex);
+            continuations.push_back(std::move(continuation));
+        }
+        if (wakeCallback) wakeCallback();
+    }
+
+    inline void finish (TaskGroup & group) {
+        if (group.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::function<void()> continuation;
+            {
+                std::lock_guard lock(group.continuationMutex);
+                continuation.swap(group.continuation);
+            }
+            if (continuation) post(std::move(continuation));
+        }
+
+        if (group.unsettled.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        {
+            std::lock_guard lock(doneMutex);    // So that a thread about to wait can't miss it
+        }
+        doneCondition.notify_all();
+    }
+
+    inline void execute (Task & task) {
+        if (!task.group->isCancelled()) {
+            PROFILE_SCOPE("JobSystem::job");
+            task.job(*task.group);
+        }
+        finish(*task.group);
+        unfinished.fetch_sub(1, std::memory_order_release);     // After finish() has posted the continuation
+    }
+
+    inline void workerLoop (uint32_t index) {
+        currentWorker = index;
+        auto & self = *workers[index];
+        Task task;
+
+        while (true) {
+            if (take(task)) {
+                int64_t start = Profiler::now();
+                execute(task);
+                task = Task();      // Drop the group before going to sleep
+                self.busyTime.fetch_add(Profiler::now() - start, std::memory_order_relaxed);
+                self.jobs.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            std::unique_lock lock(sleepMutex);
+            sleepCondition.wait(lock, []{
+                return queued.load(std::memory_order_acquire) > 0 || !running.load(std::memory_order_relaxed);
+            });
+            if (!running) break;
+        }
+    }
+
+}   // namespace internal
+
+#pragma endregion
+
+inline void TaskGroup::wait () {
+    auto settled = [this]{ return unsettled.load(std::memory_order_acquire) == 0; };
+    internal::Task task;
+    while (!settled()) {
+        if (internal::take(task, this)) {
+            internal::execute(task);
+            task = internal::Task();
+            continue;
+        }
+        std::unique_lock lock(internal::doneMutex);
+        internal::doneCondition.wait(lock, settled);
+    }
+}
+
+/**
+ * @brief Starts the worker threads
+ * @param threads Amount of workers, by default leaves a core each for the UI and render threads
+ */
+inline void init (uint32_t threads = 0) {
+    using namespace internal;
+    if (running) return;
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 3u) - 2;
+
+    running = true;
+    workers.clear();
+    for (uint32_t i = 0; i < threads; i++) {
+        workers.push_back(std::make_unique<Worker>());
+        workers.back()->counterName = std::format("Worker {} utilization %", i);
+    }
+    stats.assign(threads, WorkerStats{});
+    for (uint32_t i = 0; i < threads; i++)
+        workers[i]->thread = std::thread(workerLoop, i);
+}
+
+/**
+ * @brief Stops and joins the worker threads
+ * @note Jobs still queued once the workers have stopped are dropped and their groups cancelled,
+ * the groups still finish (so waiting on them returns) and their continuations are still queued
+ */
+inline void shutdown () {
+    using namespace internal;
+    if (!running) return;
+    {
+        std::lock_guard lock(sleepMutex);
+        running = false;
+    }
+    sleepCondition.notify_all();
+    for (auto & worker : workers)
+        if (worker->thread.joinable()) worker->thread.join();
+
+    for (auto & worker : workers) {
+        for (auto & task : worker->tasks) {
+            task.group->cancel();
+            finish(*task.group);
+            unfinished.fetch_sub(1, std::memory_order_release);
+        }
+        worker->tasks.clear();
+    }
+    workers.clear();
+    queued = 0;
+}
+
+/**
+ * @brief Set the function called (from any thread) whenever a continuation is queued for the UI thread
+ */
+inline void setWakeCallback (std::function<void()> callback) { internal::wakeCallback = std::move(callback); }
+
+inline Group createGroup () { return std::make_shared<TaskGroup>(); }
+
+/**
+ * @brief Queues a job, runs it right away if the workers aren't running
+ */
+inline void submit (const Group & group, Job job) {
+    group->pending.fetch_add(1, std::memory_order_relaxed);
+    group->unsettled.fetch_add(1, std::memory_order_relaxed);
+    internal::unfinished.fetch_add(1, std::memory_order_relaxed);
+    if (!internal::running) {
+        internal::Task task {std::move(job), group};
+        internal::execute(task);
+        return;
+    }
+    internal::push(internal::Task{std::move(job), group});
+}
+
+/**
+ * @brief Sets the function to run on the UI thread once every job of the group is done
+ * @note Submit all of the group's jobs before calling this
+ */
+inline void then (const Group & group, std::function<void()> continuation) {
+    std::unique_lock lock(group->continuationMutex);
+    if (group->isDone()) {
+        lock.unlock();
+        internal::post(std::move(continuation));
+    } else
+        group->continuation = std::move(continuation);
+}
+
+/**
+ * @brief Splits [begin, end) into jobs of up to grain iterations
+ */
+inline void parallelFor (const Group & group, size_t begin, size_t end, size_t grain, std::function<void(size_t)> function) {
+    grain = std::max(grain, (size_t)1);
+    for (size_t chunk = begin; chunk < end; chunk += grain) {
+        size_t chunkEnd = std::min(chunk + grain, end);
+        submit(group, [=](const TaskGroup & group){
+            for (size_t i = chunk; i < chunkEnd && !group.isCancelled(); i++)
+                function(i);
+        });
+    }
+}
+
+/**
+ * @brief Runs the continuations of the finished groups
+ * @note Call from the UI thread only
+ * @return Amount of continuations ran
+ */
+inline size_t runContinuations () {
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard lock(internal::continuationsMutex);
+        ready.swap(internal::continuations);
+    }
+    for (auto & continuation : ready) continuation();
+    return ready.size();
+}
+
+/**
+ * @brief Whether there are no jobs queued or running and no continuations waiting for runContinuations()
+ * @note The UI thread keeps polling until this is true, so it picks up finished work without waiting for an event
+ */
+inline bool idle () {
+    if (internal::unfinished.load(std::memory_order_acquire) > 0) return false;
+    std::lock_guard lock(internal::continuationsMutex);
+    return internal::continuations.empty();
+}
+
+/**
+ * @brief Updates the per-worker statistics and sends their utilization to the profiler
+ * @note Should only ever be called from one thread, before Profiler::frame()
+ */
+inline void frame () {
+    using namespace internal;
+    int64_t time = Profiler::now();
+    int64_t elapsed = lastFrame >= 0 ? time - lastFrame : 0;
+    lastFrame = time;
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        auto & worker = *workers[i];
+        int64_t busyTime = worker.busyTime.load(std::memory_order_relaxed);
+        uint64_t jobs = worker.jobs.load(std::memory_order_relaxed);
+        stats[i] = WorkerStats {
+            jobs - worker.lastJobs,
+            elapsed > 0 ? std::min((double)(busyTime - worker.lastBusyTime) / elapsed, 1.0) : 0
+        };
+        worker.lastBusyTime = busyTime;
+        worker.lastJobs = jobs;
+        Profiler::counter(worker.counterName.c_str(), (int64_t)(stats[i].utilization * 100));
+    }
+}
+
+/**
+ * @brief Get the statistics of every worker as of the last JobSystem::frame()
+ */
+inline const std::vector<WorkerStats> & workerStats () { return internal::stats; }
+
+}   // namespace JobSystem
+
+#endif  // __JOB_SYSTEM_INCLUDED__
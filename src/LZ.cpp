@@ -0,0 +1,176 @@
+#ifndef __LZ_INCLUDED__
+#define __LZ_INCLUDED__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+// LZ compression:
+
+/*  A byte-oriented LZ77 codec in the vein of LZ4, for the
+    compressed chunks of the project files: decoding is
+    just copies, so it's limited by memory bandwidth.
+
+    The data is a list of sequences, each of which is:
+        1 byte - the token:
+            bits 4-7 - the amount of literals, 15 meaning
+            that more length bytes follow.
+            bits 0-3 - the length of the match minus
+            MIN_MATCH, 15 meaning that more length bytes
+            follow.
+        X bytes (optional) - the rest of the amount of
+        literals, each added to it until one isn't 255.
+        X bytes - the literals, copied as they are.
+        2 bytes - the offset of the match, back from the
+        current position, little-endian, 1..MAX_OFFSET.
+        X bytes (optional) - the rest of the match length,
+        like the amount of literals.
+    The last sequence ends after its literals, without a
+    match. Matches can overlap with their own output, an
+    offset of 1 repeats the last byte.
+
+    The decompressed size is not stored, the caller has to
+    know it (the compressed chunks store it). Decoding
+    checks every read and write against the ends, so
+    corrupt data fails instead of reading out of bounds.
+*/
+
+namespace LZ {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr int HASH_BITS = 12;
+
+namespace internal {
+
+    inline uint32_t read32 (const uint8_t * ptr) {
+        uint32_t value;
+        memcpy(&value, ptr, 4);
+        return value;
+    }
+
+    inline uint32_t hash (uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    inline void writeLength (std::vector<uint8_t> & output, size_t length) {
+        for (; length >= 255; length -= 255) output.push_back(255);
+        output.push_back(length);
+    }
+
+    // Adds the length bytes following a token nibble of 15
+    inline bool readLength (const uint8_t *& ptr, const uint8_t * end, size_t & length) {
+        uint8_t byte;
+        do {
+            if (ptr == end) return false;
+            byte = *ptr++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    // A match length of 0 makes it the last sequence
+    inline void writeSequence (std::vector<uint8_t> & output, const uint8_t * literals, size_t literalCount, size_t offset, size_t matchLength) {
+        size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+        output.push_back(std::min<size_t>(literalCount, 15) << 4 | std::min<size_t>(matchCode, 15));
+        if (literalCount >= 15) writeLength(output, literalCount - 15);
+        output.insert(output.end(), literals, literals + literalCount);
+        if (!matchLength) return;
+        output.push_back(offset & 0xFF);
+        output.push_back(offset >> 8);
+        if (matchCode >= 15) writeLength(output, matchCode - 15);
+    }
+
+}
+
+/**
+ * @brief Compresses the data, greedily taking the match found through a hash table of the last positions
+ * @note Incompressible data grows by about 1/255, check whether it's worth it
+ */
+inline std::vector<uint8_t> compress (std::span<const uint8_t> input) {
+    using namespace internal;
+    std::vector<uint8_t> output;
+    output.reserve(input.size() + input.size() / 255 + 16);
+
+    uint32_t table[1 << HASH_BITS] = {};    // Position + 1 of the last time each hash was seen, 0 if never
+    const uint8_t * start = input.data(), * end = start + input.size();
+    const uint8_t * anchor = start, * ptr = start;
+
+    while (end - ptr >= (ptrdiff_t)MIN_MATCH) {
+        uint32_t sequence = read32(ptr);
+        uint32_t & entry = table[hash(sequence)];
+        const uint8_t * match = entry ? start + entry - 1 : nullptr;
+        bool found = match && (size_t)(ptr - match) <= MAX_OFFSET && read32(match) == sequence;
+        entry = ptr - start + 1;
+        if (!found) {
+            // Skip ahead faster the longer nothing matches, so incompressible data goes by quickly
+            ptr += 1 + ((ptr - anchor) >> 6);
+            continue;
+        }
+
+        while (ptr > anchor && match > start && ptr[-1] == match[-1]) { ptr--; match--; }
+        size_t length = MIN_MATCH;
+        while (ptr + length < end && ptr[length] == match[length]) length++;
+
+        writeSequence(output, anchor, ptr - anchor, ptr - match, length);
+        ptr += length;
+        anchor = ptr;
+        // The match's last position, so that the next one can start right after it
+        if (end - ptr >= (ptrdiff_t)MIN_MATCH) table[hash(read32(ptr - 2))] = ptr - 2 - start + 1;
+    }
+    writeSequence(output, anchor, end - anchor, 0, 0);
+    return output;
+}
+
+/**
+ * @brief Decompresses data made by compress()
+ * @param output Has to be exactly the size of the decompressed data
+ * @return false if the data is corrupt or doesn't fill the output exactly
+ */
+inline bool decompress (std::span<const uint8_t> input, std::span<uint8_t> output) {
+    using namespace internal;
+    const uint8_t * ptr = input.data(), * end = ptr + input.size();
+    uint8_t * out = output.data(), * outStart = out, * outEnd = out + output.size();
+
+    while (ptr < end) {
+        uint8_t token = *ptr++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(ptr, end, literals)) return false;
+        if (literals > (size_t)(end - ptr) || literals > (size_t)(outEnd - out)) return false;
+        // Most runs are short, a fixed size copy is faster if there's room to copy a little too much
+        if (end - ptr >= 16 && outEnd - out >= 16) {
+            memcpy(out, ptr, 16);
+            if (literals > 16) memcpy(out + 16, ptr + 16, literals - 16);
+        } else if (literals) memcpy(out, ptr, literals);
+        ptr += literals;
+        out += literals;
+        if (ptr == end) break;
+
+        if (end - ptr < 2) return false;
+        size_t offset = ptr[0] | ptr[1] << 8;
+        ptr += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(ptr, end, length)) return false;
+        length += MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(out - outStart) || length > (size_t)(outEnd - out)) return false;
+
+        const uint8_t * match = out - offset;
+        if (offset >= 16 && length <= 16 && outEnd - out >= 16) memcpy(out, match, 16);
+        else if (offset >= length) memcpy(out, match, length);
+        else if (offset >= 8) {
+            // Overlapping, but never within 8 bytes
+            size_t copied = 0;
+            for (; copied + 8 <= length; copied += 8) memcpy(out + copied, match + copied, 8);
+            for (; copied < length; copied++) out[copied] = match[copied];
+        } else for (size_t i = 0; i < length; i++) out[i] = match[i];
+        out += length;
+    }
+    return out == outEnd;
+}
+
+}   // namespace LZ
+
+#endif  // __LZ_INCLUDED__
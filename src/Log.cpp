@@ -0,0 +1,219 @@
+#ifndef __LOG_INCLUDED__
+#define __LOG_INCLUDED__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Leveled logging:
+
+/*  Usage:
+        LOG_INFO("Loaded %s\n", path);
+        LOG_BYTES(Log::Level::Trace, data, size);
+    Messages are printf-style. The ones less severe than
+    LOG_COMPILE_LEVEL (set by the GENECYZER_LOG_LEVEL CMake
+    option) compile to nothing, arguments included. The
+    ones less severe than the runtime level (setLevel())
+    cost a comparison: the arguments are only evaluated and
+    formatted once it passes.
+
+    Formatted messages are queued for a sink thread, so the
+    thread logging never waits on the terminal. Until
+    start() (e.g. in the tests) and after stop(), they are
+    written right away instead. Warnings and errors go to
+    stderr, the rest to stdout.
+*/
+
+// The least severe level compiled in, as a number (0 for Trace ... 5 for None)
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 1
+#endif
+
+namespace Log {
+
+enum class Level : uint8_t { Trace, Debug, Info, Warning, Error, None };
+
+// Past this many queued messages, new ones are dropped until the sink catches up
+constexpr size_t MAX_QUEUED = 1 << 14;
+
+#pragma region internal
+
+namespace internal {
+
+    struct Message {
+        Level level;
+        std::string text;
+    };
+
+    inline std::atomic<Level> level = Level::Info;
+
+    inline std::mutex mutex;                // Guards everything below
+    inline std::condition_variable condition;
+    inline std::vector<Message> queue;
+    inline bool running = false;
+    inline uint64_t dropped = 0;
+    inline FILE * output = stdout;
+    inline FILE * errorOutput = stderr;
+    inline std::thread sink;
+
+    // With mutex held
+    inline FILE * streamOf (Level level) { return level >= Level::Warning ? errorOutput : output; }
+
+    inline void enqueue (Level level, std::string && text) {
+        std::unique_lock lock(mutex);
+        if (!running) {
+            fputs(text.c_str(), streamOf(level));
+            fflush(streamOf(level));
+            return;
+        }
+        if (queue.size() >= MAX_QUEUED) { dropped++; return; }
+        queue.push_back(Message {level, std::move(text)});
+        lock.unlock();
+        condition.notify_one();
+    }
+
+    inline void sinkLoop () {
+        std::vector<Message> batch;
+        std::unique_lock lock(mutex);
+        while (true) {
+            condition.wait(lock, []{ return !queue.empty() || !running; });
+            if (queue.empty() && !running) break;
+            std::swap(batch, queue);
+            uint64_t lost = dropped;
+            dropped = 0;
+            FILE * streams[2] = {output, errorOutput};
+
+            // Written without the lock, so logging doesn't wait on the terminal either
+            lock.unlock();
+            for (auto & message : batch)
+                fputs(message.text.c_str(), message.level >= Level::Warning ? streams[1] : streams[0]);
+            if (lost) fprintf(streams[1], "[Log]: %llu messages dropped\n", (unsigned long long)lost);
+            fflush(streams[0]);
+            fflush(streams[1]);
+            batch.clear();
+            lock.lock();
+        }
+    }
+
+}
+
+#pragma endregion
+
+inline void setLevel (Level level) { internal::level.store(level, std::memory_order_relaxed); }
+inline Level level () { return internal::level.load(std::memory_order_relaxed); }
+inline bool enabled (Level level) { return level >= Log::level(); }
+
+/**
+ * @brief Parses a level name, as given on the command line
+ * @return Level::None if it isn't one
+ */
+inline Level parseLevel (const char * name) {
+    const char * names[] = {"trace", "debug", "info", "warning", "error"};
+    for (size_t i = 0; i < 5; i++)
+        if (!strcmp(name, names[i])) return (Level)i;
+    return Level::None;
+}
+
+/**
+ * @brief Sets where messages go, stdout and stderr by default
+ */
+inline void setOutput (FILE * output, FILE * errorOutput) {
+    std::lock_guard lock(internal::mutex);
+    internal::output = output;
+    internal::errorOutput = errorOutput;
+}
+
+/**
+ * @brief Starts the sink thread, from then on messages are queued
+ */
+inline void start () {
+    std::lock_guard lock(internal::mutex);
+    if (internal::running) return;
+    internal::running = true;
+    internal::sink = std::thread(internal::sinkLoop);
+}
+
+/**
+ * @brief Writes out the queued messages and stops the sink thread
+ */
+inline void stop () {
+    {
+        std::lock_guard lock(internal::mutex);
+        if (!internal::running) return;
+        internal::running = false;
+    }
+    internal::condition.notify_one();
+    internal::sink.join();
+}
+
+/**
+ * @brief Formats and writes a message, no matter the level, use the macros instead
+ * @return The length of the message
+ */
+inline int vwrite (Level level, const char * format, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(nullptr, 0, format, copy);
+    va_end(copy);
+    if (length <= 0) return length;
+    std::string text(length, '\0');
+    vsnprintf(text.data(), length + 1, format, args);
+    internal::enqueue(level, std::move(text));
+    return length;
+}
+
+inline int write (Level level, const char * format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vwrite(level, format, args);
+    va_end(args);
+    return length;
+}
+
+/**
+ * @brief Writes a hex dump, each line with divide bytes and then them as text
+ */
+inline void bytes (Level level, const void * data, size_t size, size_t divide = 16) {
+    if (divide == 0) divide = size;
+    auto * ptr = (const uint8_t *)data;
+    std::string text;
+    char hex[4];
+    for (size_t line = 0; line < size; line += divide) {
+        for (size_t i = line; i < line + divide; i++) {
+            if (i < size) snprintf(hex, sizeof(hex), "%02X ", ptr[i]);
+            text += i < size ? hex : "-- ";
+        }
+        text += "| ";
+        for (size_t i = line; i < line + divide && i < size; i++)
+            text += ptr[i] >= 0x20 && ptr[i] <= 0x7F ? std::string(1, ptr[i]) : "�";
+        text += '\n';
+    }
+    internal::enqueue(level, std::move(text));
+}
+
+}   // namespace Log
+
+#define LOG_AT(level, ...) do { \
+    if constexpr ((int)(level) >= LOG_COMPILE_LEVEL) \
+        if (Log::enabled(level)) Log::write(level, __VA_ARGS__); \
+} while (0)
+
+#define LOG_TRACE(...)      LOG_AT(Log::Level::Trace, __VA_ARGS__)
+#define LOG_DEBUG(...)      LOG_AT(Log::Level::Debug, __VA_ARGS__)
+#define LOG_INFO(...)       LOG_AT(Log::Level::Info, __VA_ARGS__)
+#define LOG_WARNING(...)    LOG_AT(Log::Level::Warning, __VA_ARGS__)
+#define LOG_ERROR(...)      LOG_AT(Log::Level::Error, __VA_ARGS__)
+
+#define LOG_BYTES(level, data, size) do { \
+    if constexpr ((int)(level) >= LOG_COMPILE_LEVEL) \
+        if (Log::enabled(level)) Log::bytes(level, data, size); \
+} while (0)
+
+#endif  // __LOG_INCLUDED__
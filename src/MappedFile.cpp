@@ -0,0 +1,155 @@
+#ifndef __MAPPED_FILE_INCLUDED__
+#define __MAPPED_FILE_INCLUDED__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <vector>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Read-only memory mapped files:
+
+/*  Maps an entire file into memory, so that it can be
+    parsed in place as a span instead of being read (and
+    copied) piece by piece. If the file can't be mapped
+    (e.g. it's empty or not a regular file), it is read
+    into a buffer instead, so data() works either way.
+
+    The span is only valid while the MappedFile is open.
+*/
+
+class MappedFile {
+    public:
+        MappedFile () {};
+        MappedFile (const char * path) { open(path); };
+        ~MappedFile () { close(); };
+
+        MappedFile (const MappedFile &) = delete;
+        MappedFile & operator= (const MappedFile &) = delete;
+
+        /**
+         * @brief Opens and maps the file, closing the previous one
+         * @return Whether the file could be opened
+         */
+        bool open (const char * path);
+        void close ();
+
+        std::span<const uint8_t> data () const { return {pointer, length}; };
+        bool isOpen () const { return opened; };
+        // Whether the file is mapped, as opposed to read into a buffer
+        bool isMapped () const { return mapped; };
+
+    private:
+        bool readFallback (const char * path);
+
+        const uint8_t * pointer = nullptr;
+        size_t length = 0;
+        bool opened = false;
+        bool mapped = false;
+        std::vector<uint8_t> buffer;
+
+        #ifdef _WIN32
+            HANDLE file = INVALID_HANDLE_VALUE;
+            HANDLE mapping = NULL;
+        #endif
+};
+
+#pragma region implementation
+
+#ifdef _WIN32
+
+bool MappedFile::open (const char * path) {
+    close();
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL)
+            pointer = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (pointer != nullptr) {
+        length = size.QuadPart;
+        mapped = opened = true;
+        return true;
+    }
+
+    close();
+    return readFallback(path);
+}
+
+void MappedFile::close () {
+    if (mapped) UnmapViewOfFile(pointer);
+    if (mapping != NULL) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+    pointer = nullptr;
+    length = 0;
+    opened = mapped = false;
+    buffer.clear();
+}
+
+#else
+
+bool MappedFile::open (const char * path) {
+    close();
+    int descriptor = ::open(path, O_RDONLY);
+    if (descriptor < 0) return false;
+
+    struct stat status;
+    if (fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+        void * address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (address != MAP_FAILED) {
+            ::close(descriptor);    // The mapping stays valid without it
+            madvise(address, status.st_size, MADV_SEQUENTIAL);
+            pointer = (const uint8_t *)address;
+            length = status.st_size;
+            mapped = opened = true;
+            return true;
+        }
+    }
+
+    ::close(descriptor);
+    return readFallback(path);
+}
+
+void MappedFile::close () {
+    if (mapped) munmap((void *)pointer, length);
+    pointer = nullptr;
+    length = 0;
+    opened = mapped = false;
+    buffer.clear();
+}
+
+#endif
+
+bool MappedFile::readFallback (const char * path) {
+    FILE * input = fopen(path, "rb");
+    if (input == nullptr) return false;
+    uint8_t block[65536];
+    size_t read;
+    while ((read = fread(block, 1, sizeof(block), input)) > 0)
+        buffer.insert(buffer.end(), block, block + read);
+    fclose(input);
+    pointer = buffer.data();
+    length = buffer.size();
+    opened = true;
+    return true;
+}
+
+#pragma endregion
+
+#endif  // __MAPPED_FILE_INCLUDED__
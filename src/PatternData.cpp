@@ -0,0 +1,458 @@
+#ifndef __PATTERN_DATA_INCLUDED__
+#define __PATTERN_DATA_INCLUDED__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Hash.cpp"
+#include "Tile.cpp"
+#include "Effect.cpp"
+#include "Tracker.cpp"
+
+// Pattern storage:
+
+/*  The rows of a pattern are stored column-wise: one array
+    each for the note values, instruments and flags, and one
+    for the effects, in which every row gets a fixed amount
+    of EffectSlots (the pattern's effect capacity, which
+    follows the effect column amount of its channel). So a
+    pattern takes 3 + 5 * capacity bytes per row and a
+    handful of allocations in total, no matter how many of
+    its cells have effects, and going through it is a linear
+    walk over each array.
+
+    Most rows of a typical pattern are empty though (an
+    empty note, no instrument, no effects), so a pattern can
+    also be stored sparsely: the same columns only hold the
+    non-empty rows, and sparseRows holds their row numbers in
+    order. The storage is picked by density on its own every
+    time a row changes, with some hysteresis so that it does
+    not flip back and forth.
+
+    Going through the rows in order should be done with the
+    iterator (for (auto row : pattern)), which walks the
+    sparse entries alongside instead of searching for every
+    row. forEachEvent() only visits the non-empty rows.
+
+    TrackerCell stays as the value type for a single cell,
+    cell() and setCell() convert from and to it.
+*/
+
+class PatternData {
+    public:
+        enum class Storage : uint8_t { Dense, Sparse };
+
+        struct Row {
+            size_t row;
+            uint8_t noteValue;
+            uint8_t instrument;
+            uint8_t flags;
+            uint8_t effectCount;
+            const EffectSlot * effects;     // nullptr if effectCount is 0
+
+            bool empty () const { return effectCount == 0 && noteValue == EMPTY_CELL.noteValue &&
+                instrument == EMPTY_CELL.instrument && flags == EMPTY_CELL.flags; };
+            TrackerCell toCell () const;
+            // Same as std::hash<TrackerCell> of toCell()
+            size_t hash () const {
+                return std::hash<TrackerCell>::fields(noteValue, instrument, flags, effectCount, [this](size_t i){
+                    return std::hash<EffectSlot>{}(effects[i]);
+                });
+            };
+        };
+
+        class Iterator {
+            public:
+                Row operator* () const { return data->rowAt(row, entry); };
+                Iterator & operator++ () {
+                    if (entry < data->entries() && data->entryRow(entry) == row) entry++;
+                    row++;
+                    return *this;
+                };
+                bool operator!= (const Iterator & other) const { return row != other.row; };
+
+            private:
+                friend class PatternData;
+                Iterator (const PatternData * data, size_t row, size_t entry) : data(data), row(row), entry(entry) {};
+
+                const PatternData * data;
+                size_t row;
+                size_t entry;   // First entry at or after row
+        };
+
+        PatternData (size_t rows = 0, uint8_t effectCapacity = 0);
+
+        size_t size () const { return rows; };
+        bool empty () const { return rows == 0; };
+        uint8_t effectCapacity () const { return capacity; };
+        Storage storage () const { return mode; };
+        // Amount of rows that are not empty
+        size_t events () const;
+
+        /**
+         * @brief Resizes the pattern, new rows are empty cells
+         */
+        void resize (size_t rows);
+
+        /**
+         * @brief Reserves room for that many non-empty rows, so that filling the pattern in doesn't reallocate
+         */
+        void reserve (size_t events);
+
+        /**
+         * @brief Changes the amount of effect slots per row
+         * @note Shrinking it drops the effects that don't fit anymore
+         */
+        void setEffectCapacity (uint8_t effectCapacity);
+
+        /**
+         * @brief Appends a row, growing the effect capacity if the cell needs it
+         */
+        void push_back (const TrackerCell & cell);
+
+        TrackerCell cell (size_t row) const;
+        void setCell (size_t row, const TrackerCell & cell);
+
+        uint8_t noteValue (size_t row) const { size_t i = find(row); return i == NONE ? EMPTY_CELL.noteValue : noteValues[i]; };
+        uint8_t instrument (size_t row) const { size_t i = find(row); return i == NONE ? EMPTY_CELL.instrument : instruments[i]; };
+        uint8_t flags (size_t row) const { size_t i = find(row); return i == NONE ? EMPTY_CELL.flags : cellFlags[i]; };
+        uint8_t effectCount (size_t row) const { size_t i = find(row); return i == NONE ? 0 : countEffects(i); };
+        const EffectSlot * effects (size_t row) const { size_t i = find(row); return i == NONE ? nullptr : effectSlots.data() + i * capacity; };
+
+        Iterator begin () const { return Iterator(this, 0, 0); };
+        Iterator end () const { return Iterator(this, rows, entries()); };
+
+        /**
+         * @brief Calls function(const Row &) for every non-empty row, in order
+         */
+        template <typename Function>
+        void forEachEvent (Function && function) const;
+
+        /**
+         * @brief Renders a row straight into a matrix
+         * @param row
+         * @param output
+         * @param x
+         * @param y
+         * @param effectColumns
+         * @param singleTile
+         */
+        void renderRow (size_t row, TileMatrix & output, uint16_t x, uint16_t y, uint16_t effectColumns, bool singleTile) const;
+
+        /**
+         * @brief Get the amount of heap memory used by the pattern
+         * @return In bytes
+         */
+        size_t memoryUsage () const;
+
+        /**
+         * @brief Hashes the rows, regardless of the storage and effect capacity
+         * @note Equal patterns have equal content hashes
+         */
+        size_t contentHash () const;
+
+        /**
+         * @brief Switches to the storage that fits the pattern's density, regardless of hysteresis
+         */
+        void optimize ();
+
+        const bool operator==(const PatternData & other) const;
+        const bool operator!=(const PatternData & other) const { return !(*this == other); };
+
+        static inline const TrackerCell EMPTY_CELL {};
+
+    private:
+        static constexpr size_t NONE = SIZE_MAX;
+
+        // Index into the columns, NONE if the row is empty (sparse storage only)
+        size_t find (size_t row) const;
+        size_t entries () const { return noteValues.size(); };
+        size_t entryRow (size_t entry) const { return mode == Storage::Dense ? entry : sparseRows[entry]; };
+        uint8_t countEffects (size_t entry) const;
+        Row rowAt (size_t row, size_t entry) const;
+
+        void insertEntry (size_t entry, size_t row);
+        void eraseEntry (size_t entry);
+        void writeEntry (size_t entry, const TrackerCell & cell);
+
+        size_t denseBytes () const { return rows * (3 + capacity * sizeof(EffectSlot)); };
+        size_t sparseBytes (size_t events) const { return events * (sizeof(uint32_t) + 3 + capacity * sizeof(EffectSlot)); };
+        void updateStorage ();
+        void toDense ();
+        void toSparse ();
+
+        Storage mode = Storage::Sparse;
+        size_t rows = 0;
+        uint8_t capacity;
+        size_t nonEmpty = 0;                    // Only kept up to date in dense storage
+
+        std::vector<uint32_t> sparseRows;       // Row of every entry, sparse storage only
+        std::vector<uint8_t> noteValues;
+        std::vector<uint8_t> instruments;
+        std::vector<uint8_t> cellFlags;
+        std::vector<EffectSlot> effectSlots;    // capacity slots per entry, the used ones first
+};
+
+#pragma region implementation
+
+PatternData::PatternData (size_t rows, uint8_t effectCapacity) : capacity(effectCapacity) {
+    resize(rows);
+}
+
+size_t PatternData::events () const {
+    return mode == Storage::Dense ? nonEmpty : sparseRows.size();
+}
+
+void PatternData::resize (size_t newRows) {
+    if (mode == Storage::Dense) {
+        for (size_t entry = newRows; entry < rows; entry++)
+            if (!rowAt(entry, entry).empty()) nonEmpty--;
+        noteValues.resize(newRows, EMPTY_CELL.noteValue);
+        instruments.resize(newRows, EMPTY_CELL.instrument);
+        cellFlags.resize(newRows, EMPTY_CELL.flags);
+        effectSlots.resize(newRows * capacity);
+    } else {
+        auto end = std::lower_bound(sparseRows.begin(), sparseRows.end(), newRows);
+        size_t kept = end - sparseRows.begin();
+        sparseRows.resize(kept);
+        noteValues.resize(kept);
+        instruments.resize(kept);
+        cellFlags.resize(kept);
+        effectSlots.resize(kept * capacity);
+    }
+    rows = newRows;
+    updateStorage();
+}
+
+void PatternData::reserve (size_t events) {
+    if (mode == Storage::Dense) return;     // Already has every row
+    sparseRows.reserve(events);
+    noteValues.reserve(events);
+    instruments.reserve(events);
+    cellFlags.reserve(events);
+    effectSlots.reserve(events * capacity);
+}
+
+void PatternData::setEffectCapacity (uint8_t effectCapacity) {
+    if (effectCapacity == capacity) return;
+    std::vector<EffectSlot> newSlots(entries() * effectCapacity);
+    uint8_t kept = std::min(effectCapacity, capacity);
+    for (size_t entry = 0; entry < entries(); entry++)
+        std::copy_n(effectSlots.begin() + entry * capacity, kept, newSlots.begin() + entry * effectCapacity);
+    effectSlots.swap(newSlots);
+    bool shrunk = effectCapacity < capacity;
+    capacity = effectCapacity;
+
+    // Dropping effects may have emptied some rows
+    if (!shrunk) return;
+    if (mode == Storage::Dense) {
+        nonEmpty = 0;
+        for (auto row : *this) nonEmpty += !row.empty();
+    } else {
+        for (size_t entry = entries(); entry-- > 0;)
+            if (rowAt(sparseRows[entry], entry).empty()) eraseEntry(entry);
+    }
+    updateStorage();
+}
+
+void PatternData::push_back (const TrackerCell & cell) {
+    if (cell.effects.size() > capacity)
+        setEffectCapacity(std::min(cell.effects.size(), (size_t)UINT8_MAX));
+    resize(rows + 1);
+    setCell(rows - 1, cell);
+}
+
+TrackerCell PatternData::cell (size_t row) const {
+    size_t entry = find(row);
+    return entry == NONE ? EMPTY_CELL : rowAt(row, entry).toCell();
+}
+
+TrackerCell PatternData::Row::toCell () const {
+    TrackerCell output;
+    output.noteValue = noteValue;
+    output.instrument = instrument;
+    output.flags = flags;
+    for (uint8_t i = 0; i < effectCount; i++)
+        output.effects.push_back(effects[i].toEffect());
+    return output;
+}
+
+void PatternData::setCell (size_t row, const TrackerCell & cell) {
+    if (row >= rows) return;
+    bool isEmpty = cell == EMPTY_CELL;
+
+    if (mode == Storage::Dense) {
+        bool wasEmpty = rowAt(row, row).empty();
+        writeEntry(row, cell);
+        nonEmpty += (size_t)wasEmpty - (size_t)isEmpty;
+    } else {
+        auto position = std::lower_bound(sparseRows.begin(), sparseRows.end(), row);
+        size_t entry = position - sparseRows.begin();
+        bool exists = position != sparseRows.end() && *position == row;
+        if (isEmpty) {
+            if (exists) eraseEntry(entry);
+        } else {
+            if (!exists) insertEntry(entry, row);
+            writeEntry(entry, cell);
+        }
+    }
+    updateStorage();
+}
+
+void PatternData::renderRow (size_t row, TileMatrix & output, uint16_t x, uint16_t y, uint16_t effectColumns, bool singleTile) const {
+    size_t entry = find(row);
+    if (entry == NONE)
+        TrackerCell::renderInto(output, x, y,
+            EMPTY_CELL.noteValue, EMPTY_CELL.instrument, EMPTY_CELL.flags, 0,
+            effectColumns, singleTile);
+    else
+        TrackerCell::renderInto(output, x, y,
+            noteValues[entry], instruments[entry], cellFlags[entry], countEffects(entry),
+            effectColumns, singleTile);
+}
+
+template <typename Function>
+void PatternData::forEachEvent (Function && function) const {
+    for (size_t entry = 0; entry < entries(); entry++) {
+        Row row = rowAt(entryRow(entry), entry);
+        if (mode == Storage::Sparse || !row.empty()) function(row);
+    }
+}
+
+size_t PatternData::memoryUsage () const {
+    return
+        sparseRows.capacity() * sizeof(uint32_t) +
+        noteValues.capacity() + instruments.capacity() + cellFlags.capacity() +
+        effectSlots.capacity() * sizeof(EffectSlot);
+}
+
+size_t PatternData::contentHash () const {
+    uint64_t hash = Hash::combine(Hash::SEED, rows);
+    forEachEvent([&](const Row & row){
+        hash = Hash::combine(hash, Hash::combine(row.row, row.hash()));
+    });
+    return hash;
+}
+
+void PatternData::optimize () {
+    if (sparseBytes(events()) < denseBytes()) toSparse();
+    else toDense();
+}
+
+const bool PatternData::operator==(const PatternData & other) const {
+    if (rows != other.rows) return false;
+    auto a = begin(), b = other.begin();
+    for (; a != end(); ++a, ++b) {
+        Row x = *a, y = *b;
+        if (x.noteValue != y.noteValue || x.instrument != y.instrument ||
+            x.flags != y.flags || x.effectCount != y.effectCount)
+            return false;
+        for (uint8_t i = 0; i < x.effectCount; i++)
+            if (!(x.effects[i] == y.effects[i])) return false;
+    }
+    return true;
+}
+
+#pragma endregion
+#pragma region internal
+
+size_t PatternData::find (size_t row) const {
+    if (row >= rows) return NONE;
+    if (mode == Storage::Dense) return row;
+    auto position = std::lower_bound(sparseRows.begin(), sparseRows.end(), row);
+    return position != sparseRows.end() && *position == row ? position - sparseRows.begin() : NONE;
+}
+
+uint8_t PatternData::countEffects (size_t entry) const {
+    auto * slots = effectSlots.data() + entry * capacity;
+    uint8_t count = 0;
+    while (count < capacity && !slots[count].empty()) count++;
+    return count;
+}
+
+PatternData::Row PatternData::rowAt (size_t row, size_t entry) const {
+    if (entry >= entries() || entryRow(entry) != row)
+        return Row { row, EMPTY_CELL.noteValue, EMPTY_CELL.instrument, EMPTY_CELL.flags, 0, nullptr };
+    uint8_t count = countEffects(entry);
+    return Row {
+        row, noteValues[entry], instruments[entry], cellFlags[entry],
+        count, count ? effectSlots.data() + entry * capacity : nullptr
+    };
+}
+
+void PatternData::insertEntry (size_t entry, size_t row) {
+    sparseRows.insert(sparseRows.begin() + entry, row);
+    noteValues.insert(noteValues.begin() + entry, 0);
+    instruments.insert(instruments.begin() + entry, 0);
+    cellFlags.insert(cellFlags.begin() + entry, 0);
+    effectSlots.insert(effectSlots.begin() + entry * capacity, capacity, EffectSlot());
+}
+
+void PatternData::eraseEntry (size_t entry) {
+    sparseRows.erase(sparseRows.begin() + entry);
+    noteValues.erase(noteValues.begin() + entry);
+    instruments.erase(instruments.begin() + entry);
+    cellFlags.erase(cellFlags.begin() + entry);
+    effectSlots.erase(effectSlots.begin() + entry * capacity, effectSlots.begin() + (entry + 1) * capacity);
+}
+
+void PatternData::writeEntry (size_t entry, const TrackerCell & cell) {
+    noteValues[entry] = cell.noteValue;
+    instruments[entry] = cell.instrument;
+    cellFlags[entry] = cell.flags;
+    auto * slots = effectSlots.data() + entry * capacity;
+    for (uint8_t i = 0; i < capacity; i++)
+        slots[i] = i < cell.effects.size() ? EffectSlot::fromEffect(cell.effects[i]) : EffectSlot();
+}
+
+void PatternData::updateStorage () {
+    // Sparse until it would take half of the dense size, dense until it would take a quarter
+    size_t sparse = sparseBytes(events()), dense = denseBytes();
+    if (mode == Storage::Sparse && sparse * 2 > dense) toDense();
+    else if (mode == Storage::Dense && sparse * 4 < dense) toSparse();
+}
+
+void PatternData::toDense () {
+    if (mode == Storage::Dense) return;
+    PatternData dense;
+    dense.mode = Storage::Dense;
+    dense.capacity = capacity;
+    dense.rows = rows;
+    dense.nonEmpty = sparseRows.size();
+    dense.noteValues.assign(rows, EMPTY_CELL.noteValue);
+    dense.instruments.assign(rows, EMPTY_CELL.instrument);
+    dense.cellFlags.assign(rows, EMPTY_CELL.flags);
+    dense.effectSlots.assign(rows * capacity, EffectSlot());
+    for (size_t entry = 0; entry < sparseRows.size(); entry++) {
+        size_t row = sparseRows[entry];
+        dense.noteValues[row] = noteValues[entry];
+        dense.instruments[row] = instruments[entry];
+        dense.cellFlags[row] = cellFlags[entry];
+        std::copy_n(effectSlots.begin() + entry * capacity, capacity, dense.effectSlots.begin() + row * capacity);
+    }
+    *this = std::move(dense);
+}
+
+void PatternData::toSparse () {
+    if (mode == Storage::Sparse) return;
+    PatternData sparse;
+    sparse.mode = Storage::Sparse;
+    sparse.capacity = capacity;
+    sparse.rows = rows;
+    forEachEvent([&](const Row & row){
+        sparse.sparseRows.push_back(row.row);
+        sparse.noteValues.push_back(row.noteValue);
+        sparse.instruments.push_back(row.instrument);
+        sparse.cellFlags.push_back(row.flags);
+        size_t offset = sparse.effectSlots.size();
+        sparse.effectSlots.resize(offset + capacity);
+        std::copy_n(effectSlots.begin() + row.row * capacity, capacity, sparse.effectSlots.begin() + offset);
+    });
+    *this = std::move(sparse);
+}
+
+#pragma endregion
+
+#endif  // __PATTERN_DATA_INCLUDED__
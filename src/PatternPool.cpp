@@ -0,0 +1,112 @@
+#ifndef __PATTERN_POOL_INCLUDED__
+#define __PATTERN_POOL_INCLUDED__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "PatternData.cpp"
+
+// Pattern interning:
+
+/*  Songs hold their pattern data as shared pointers to
+    const PatternData, and PatternPool::intern() hands out
+    the same pointer for every pattern with the same
+    content, across channels, songs and projects. The pool
+    itself only keeps weak pointers, keyed by the content
+    hash, so a pattern goes away once no song uses it and
+    use_count() is the amount of places sharing it.
+
+    The effect capacity is part of the key: patterns with
+    the same rows but a different capacity stay apart, so
+    that interning never hands a pattern fitted to its
+    channels' effect columns back with less room, which
+    the next edit would drop effects over.
+
+    Interned patterns are never modified in place, since
+    any thread may be comparing against them: editing goes
+    through Song::editPattern(), which makes a private copy
+    of an interned pattern first (copy-on-write). Private
+    copies are edited in place from then on, as long as
+    nothing else holds them, and go back into the pool with
+    Song::internPatterns().
+
+    The pool is locked, so patterns can be interned from
+    the job system's workers.
+*/
+
+using SharedPattern = std::shared_ptr<const PatternData>;
+
+namespace PatternPool {
+
+struct Stats {
+    uint64_t lookups;   // Calls to intern()
+    uint64_t hits;      // Of which returned an already interned pattern
+    size_t entries;     // Entries in the table, including ones of patterns that are gone
+};
+
+namespace internal {
+    inline std::mutex mutex;
+    inline std::unordered_multimap<size_t, std::weak_ptr<const PatternData>> table;
+    inline Stats stats {};
+
+    inline size_t key (const PatternData & data) {
+        return Hash::combine(data.contentHash(), data.effectCapacity());
+    }
+
+    // Has to be called with the mutex held
+    inline SharedPattern lookup (size_t hash, const PatternData & data) {
+        auto [first, last] = table.equal_range(hash);
+        for (auto it = first; it != last;) {
+            SharedPattern existing = it->second.lock();
+            if (!existing) { it = table.erase(it); continue; }
+            if (existing->effectCapacity() == data.effectCapacity() && *existing == data) return existing;
+            ++it;
+        }
+        return nullptr;
+    }
+}   // namespace internal
+
+/**
+ * @brief Get the shared copy of a pattern with the same content and effect capacity, or make this one it
+ */
+inline SharedPattern intern (const SharedPattern & data) {
+    using namespace internal;
+    if (!data) return data;
+    size_t hash = key(*data);
+
+    std::lock_guard lock(mutex);
+    stats.lookups++;
+    if (auto existing = lookup(hash, *data)) {
+        stats.hits++;
+        return existing;
+    }
+    table.emplace(hash, data);
+    return data;
+}
+
+inline SharedPattern intern (PatternData && data) {
+    return intern(std::make_shared<const PatternData>(std::move(data)));
+}
+
+/**
+ * @brief Drops the entries of the patterns that are not used anymore
+ */
+inline void collect () {
+    using namespace internal;
+    std::lock_guard lock(mutex);
+    for (auto it = table.begin(); it != table.end();)
+        it = it->second.expired() ? table.erase(it) : std::next(it);
+}
+
+inline Stats stats () {
+    std::lock_guard lock(internal::mutex);
+    internal::stats.entries = internal::table.size();
+    return internal::stats;
+}
+
+}   // namespace PatternPool
+
+#endif  // __PATTERN_POOL_INCLUDED__
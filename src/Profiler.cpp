@@ -0,0 +1,282 @@
+#ifndef __PROFILER_INCLUDED__
+#define __PROFILER_INCLUDED__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Hot path profiler:
+
+/*  Usage:
+        PROFILE_SCOPE("Name");
+    at the beginning of any block records the time spent
+    in it under "Name" (which has to be a string literal,
+    or at least outlive the profiler). Every thread gets
+    its own lock-free ring buffer of events, which the
+    main thread drains once per frame in Profiler::frame(),
+    feeding the per-scope rolling statistics and the trace
+    that can be exported to the Chrome trace event format
+    (chrome://tracing, Perfetto, Speedscope).
+
+    Without PROFILER_ENABLED defined, PROFILE_SCOPE
+    compiles to nothing. The frame timing still works.
+*/
+
+namespace Profiler {
+
+// Must be a power of 2
+constexpr size_t RING_SIZE      = 1 << 14;
+// Amount of samples the percentiles are calculated from
+constexpr size_t ROLLING_WINDOW = 256;
+// Amount of events kept for exporting
+constexpr size_t TRACE_SIZE     = 1 << 18;
+
+struct Event {
+    enum class Type : uint8_t { Scope, Counter };
+
+    const char * name;
+    int64_t start;      // In nanoseconds since the profiler's epoch
+    int64_t duration;   // In nanoseconds, the value itself for counters
+    uint32_t thread;
+    Type type;
+};
+
+struct ScopeStats {
+    const char * name;
+    uint64_t count;
+    double p50;         // In microseconds
+    double p99;         // In microseconds
+    double max;         // In microseconds
+};
+
+#pragma region internal
+
+namespace internal {
+
+    using clock = std::chrono::steady_clock;
+    inline const clock::time_point epoch = clock::now();
+
+    inline int64_t now () {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - epoch).count();
+    }
+
+    struct ThreadBuffer {
+        std::array<Event, RING_SIZE> events;
+        std::atomic<uint64_t> head {0};     // Only written by the owning thread
+        uint64_t tail = 0;                  // Only touched by the draining thread
+        uint32_t thread;
+    };
+
+    struct RollingWindow {
+        std::array<int64_t, ROLLING_WINDOW> samples;
+        uint64_t count = 0;
+
+        void push (int64_t sample) { samples[count++ % ROLLING_WINDOW] = sample; }
+    };
+
+    inline std::mutex registryMutex;
+    inline std::vector<std::shared_ptr<ThreadBuffer>> registry;     // Kept alive after the thread exits
+
+    // Only accessed from the thread calling Profiler::frame()
+    inline std::unordered_map<const char *, RollingWindow> windows;
+    inline std::vector<const char *> scopeOrder;
+    inline std::vector<Event> trace;
+    inline size_t traceHead = 0;
+    inline RollingWindow frameTimes;
+    inline int64_t lastFrame = -1;
+
+    inline ThreadBuffer & threadBuffer () {
+        thread_local std::shared_ptr<ThreadBuffer> buffer = []{
+            auto newBuffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard lock(registryMutex);
+            newBuffer->thread = registry.size();
+            registry.push_back(newBuffer);
+            return newBuffer;
+        }();
+        return *buffer;
+    }
+
+    inline void record (const char * name, int64_t start, int64_t duration, Event::Type type = Event::Type::Scope) {
+        auto & buffer = threadBuffer();
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        // Pairs with the fence in frame(), so a drain that copies this slot halfway sees the new head afterwards
+        std::atomic_thread_fence(std::memory_order_release);
+        buffer.events[head & (RING_SIZE-1)] = Event{name, start, duration, buffer.thread, type};
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    inline double percentile (const RollingWindow & window, double fraction) {
+        size_t size = std::min(window.count, (uint64_t)ROLLING_WINDOW);
+        if (size == 0) return 0;
+        std::array<int64_t, ROLLING_WINDOW> sorted;
+        std::copy_n(window.samples.begin(), size, sorted.begin());
+        auto nth = sorted.begin() + std::min((size_t)(fraction * size), size - 1);
+        std::nth_element(sorted.begin(), nth, sorted.begin() + size);
+        return *nth / 1000.0;
+    }
+
+}   // namespace internal
+
+#pragma endregion
+
+class Scope {
+    public:
+        explicit Scope (const char * name) : name(name), start(internal::now()) {};
+        ~Scope () { internal::record(name, start, internal::now() - start); };
+
+        Scope (const Scope &) = delete;
+        Scope & operator= (const Scope &) = delete;
+
+    private:
+        const char * name;
+        int64_t start;
+};
+
+/**
+ * @brief Get the current time on the profiler's clock
+ * @return Nanoseconds since the profiler's epoch
+ */
+inline int64_t now () { return internal::now(); }
+
+/**
+ * @brief Records a measurement that is not tied to a scope, e.g. an interval between two events
+ * @param name 
+ * @param start In nanoseconds since the profiler's epoch
+ * @param duration In nanoseconds
+ */
+inline void sample (const char * name, int64_t start, int64_t duration) {
+    internal::record(name, start, duration);
+}
+
+/**
+ * @brief Records the value of a counter, only shows up in the exported trace
+ * @param name 
+ * @param value 
+ */
+inline void counter (const char * name, int64_t value) {
+    internal::record(name, internal::now(), value, Event::Type::Counter);
+}
+
+/**
+ * @brief Marks the end of a frame and drains every thread's ring buffer
+ * @note Should only ever be called from one thread
+ */
+inline void frame () {
+    using namespace internal;
+
+    int64_t time = internal::now();
+    if (lastFrame >= 0) frameTimes.push(time - lastFrame);
+    lastFrame = time;
+
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard lock(registryMutex);
+        buffers = registry;
+    }
+
+    for (auto & buffer : buffers) {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        if (head - buffer->tail > RING_SIZE)    // The thread has lapped us, the oldest events are lost
+            buffer->tail = head - RING_SIZE;
+        while (buffer->tail < head) {
+            Event event = buffer->events[buffer->tail & (RING_SIZE-1)];
+
+            // The thread may have lapped us while we were copying, leaving a torn event
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t newHead = buffer->head.load(std::memory_order_acquire);
+            if (newHead - buffer->tail >= RING_SIZE) {
+                buffer->tail = newHead - RING_SIZE + 1;
+                continue;
+            }
+            buffer->tail++;
+
+            if (trace.size() < TRACE_SIZE) trace.push_back(event);
+            else trace[traceHead++ % TRACE_SIZE] = event;
+
+            if (event.type != Event::Type::Scope) continue;
+
+            auto window = windows.find(event.name);
+            if (window == windows.end()) {
+                window = windows.emplace(event.name, RollingWindow()).first;
+                scopeOrder.push_back(event.name);
+            }
+            window->second.push(event.duration);
+        }
+    }
+}
+
+/**
+ * @brief Get the rolling frame time percentiles
+ * @return ScopeStats named "Frame"
+ */
+inline ScopeStats frameStats () {
+    using namespace internal;
+    return ScopeStats {
+        "Frame", frameTimes.count,
+        percentile(frameTimes, 0.5), percentile(frameTimes, 0.99), percentile(frameTimes, 1)
+    };
+}
+
+/**
+ * @brief Get the rolling percentiles of every scope, in order of first appearance
+ */
+inline std::vector<ScopeStats> scopeStats () {
+    using namespace internal;
+    std::vector<ScopeStats> output;
+    for (auto name : scopeOrder) {
+        auto & window = windows[name];
+        output.push_back(ScopeStats {
+            name, window.count,
+            percentile(window, 0.5), percentile(window, 0.99), percentile(window, 1)
+        });
+    }
+    return output;
+}
+
+/**
+ * @brief Writes the collected events as Chrome trace event JSON
+ * @param path
+ * @return Whether the file has been written
+ */
+inline bool exportChromeTrace (const char * path) {
+    using namespace internal;
+    FILE * file = fopen(path, "wb");
+    if (file == nullptr) return false;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    size_t start = trace.size() < TRACE_SIZE ? 0 : traceHead % TRACE_SIZE;
+    for (size_t i = 0; i < trace.size(); i++) {
+        const Event & event = trace[(start + i) % trace.size()];
+        if (event.type == Event::Type::Counter)
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+                i ? ",\n" : "\n", event.name, event.thread, event.start / 1000.0, (long long)event.duration);
+        else
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                i ? ",\n" : "\n", event.name, event.thread, event.start / 1000.0, event.duration / 1000.0);
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
+
+}   // namespace Profiler
+
+#define PROFILER_CONCAT_INTERNAL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INTERNAL(a, b)
+
+#ifdef PROFILER_ENABLED
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILER_CONCAT(__profilerScope, __LINE__) (name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+#endif  // __PROFILER_INCLUDED__
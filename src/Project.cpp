@@ -7,6 +7,8 @@
 #include <cstring>
 #include <exception>
 #include <fstream>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -44,25 +46,59 @@ struct ProjectMetadata {
 	const std::string & comments;
 };
 
+class Project;
+
+namespace RIFFLoader {
+    struct LazySongs;
+    // owner keeps data alive, songs are only loaded lazily with one
+    int loadRIFFFile (std::span<const uint8_t> data, Project & project, std::shared_ptr<const void> owner = nullptr);
+    int saveRIFFFile (RIFF::RIFFWriter & file, const Project & project);
+}
+
 class Project {
     public:
 		// Create new default project
 		static Project createDefault ();
 
+        // Load, Save and the lazy song loading are implemented in RIFFLoader.cpp
+
+        /* If the file has a table of contents, loading from a
+           path or a filestream only decodes the first song, the
+           others are decoded by song() the first time they're
+           needed, from the file kept open (or in memory) until
+           then. Saving copies the songs that aren't decoded yet
+           straight from it, so call loadAllSongs() before
+           overwriting the file the project was loaded from.
+        */
+
+        // Load project from a file, memory mapping it
+        int Load (const char * path);
         // Load project from filestream
         int Load (std::ifstream & file);
-        // Load project from memory
-        int Load (const std::vector<uint8_t>& data);
+        // Load project from memory, which has to stay valid until it returns, so every song is decoded
+        int Load (std::span<const uint8_t> data);
 
         // Save project to filestream
         void Save (std::ofstream & file) const;
         // Save project to memory
         uint8_t * Save (size_t & size_out) const;
 
+        /**
+         * @brief Get a song, decoding it first if it hasn't been yet
+         */
+        Song & song (size_t index);
+        size_t songCount () const { return songs.size(); };
+        bool isSongLoaded (size_t index) const { return index >= pendingSongs.size() || !pendingSongs[index]; };
+
+        /**
+         * @brief Decodes every song that hasn't been yet and lets go of the file
+         */
+        void loadAllSongs ();
+
         // Export project's patterns to SNESFM opcode format
         uint8_t * exportSNESFM () const;
 
-        // The songs
+        // The songs, the ones not loaded yet are empty, so go through song() unless it's all of them
         std::vector<Song> songs;
 
         // Global instruments
@@ -83,6 +119,12 @@ class Project {
 
 
     private:
+        friend int RIFFLoader::loadRIFFFile (std::span<const uint8_t> data, Project & project, std::shared_ptr<const void> owner);
+        friend int RIFFLoader::saveRIFFFile (RIFF::RIFFWriter & file, const Project & project);
+
+        // Where the songs not loaded yet are in the file
+        std::shared_ptr<const RIFFLoader::LazySongs> lazySongs;
+        std::vector<bool> pendingSongs;
 
         std::string __name;
         std::string __composer;
@@ -110,42 +152,6 @@ Project Project::createDefault() {
     return project;
 }
 
-int Project::Load(const std::vector<uint8_t>& __data) {
-    auto file = RIFF::RIFFReader();
-    auto errCode = file.open(__data.data());
-    if (errCode) return errCode;
-    // loadInternal(file);
-    // auto errdata = file.readChunkData();
-    // if (errdata->errorCode) return errdata->errorCode;
-    // auto data = *(errdata->data);
-    return 0;
-}
-
-int Project::Load(std::ifstream & __file) {
-    auto file = RIFF::RIFFReader();
-    auto errCode = file.open(__file);
-    if (errCode) return errCode;
-    // return loadInternal (file);
-    return 0;
-}
-
-void Project::Save (std::ofstream & file) const{
-
-}
-
-uint8_t * Project::Save(size_t & size_out) const{
-    RIFF::RIFFWriter writer;
-
-    writer.openMem();
-
-    // saveInternal(writer);
-
-    writer.close();
-    size_out = writer().size;
-    uint8_t * outMem = (uint8_t *)writer.file;
-    return outMem;
-}
-
 const ProjectMetadata Project::exportMetadata() const{
 	return ProjectMetadata {
 		__name, __composer, __copyright, __comments
@@ -1,7 +1,12 @@
+#ifndef __RIFFLOADER_INCLUDED__
+#define __RIFFLOADER_INCLUDED__
+
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <span>
 #include <sys/types.h>
 #include <unordered_map>
 #include <vector>
@@ -10,8 +15,13 @@
 #include "Tracker.cpp"
 #include "riff.hpp"
 #include "Utils.cpp"
+#include "Log.cpp"
 #include "Var16.cpp"
+#include "LZ.cpp"
+#include "Profiler.cpp"
+#include "JobSystem.cpp"
 
+#include "MappedFile.cpp"
 #include "Project.cpp"
 #include "Song.cpp"
 // #include "Instrument.cpp"
@@ -52,6 +62,22 @@
                 stuff might break.
             4 bytes [16:19] -
                 the version of the files inside that branch.
+                On "Dev Main", version 1 added the "cmpr"
+                chunks. Files without any are still saved as
+                version 0, so that older builds can read them.
+
+        "toc " - Table of contents, optional, comes before the
+        songs so that they can be loaded lazily without going
+        through every one of their chunks:
+            4 bytes - the amount of songs. For each song:
+                4 bytes - the offset of its LIST chunk's
+                header from the start of the file.
+                4 bytes - the amount of its chunks. For each:
+                    4 bytes - the offset of the chunk's data
+                    from the start of the file.
+                    4 bytes - the length of the chunk's data.
+            Entries that don't match the file are ignored, the
+            song's chunks are then read as usual.
 
         "LIST" - The list chunk as per the RIFF spec. Several
         types are in use by Genecyzer:
@@ -114,7 +140,7 @@
                         bit 7 - whether the note has attack
                         enabled,
                         bit 6 - whether an instrument value
-                        is set,      
+                        is set (if not, it is 0 and hidden),
                         bit 5 - whether any effects are 
                         declared,
                         bit 4 - whether to set this cell as
@@ -143,19 +169,121 @@
 					(flag byte)
 						Only present if bit 1 is set in the
 						flags byte. Var16 format.
+            "cmpr" chunk - a "note" or "ptrn" chunk compressed
+            with the LZ codec (see LZ.cpp). Only used for the
+            chunks of at least COMPRESSION_THRESHOLD bytes that
+            it makes smaller:
+                4 bytes - the ID of the chunk inside.
+                4 bytes - the length of its data.
+                X bytes - its data, compressed.
+            Chunks inside with other IDs are ignored.
 
         
 */
 
 namespace RIFFLoader {
 
-Song loadSongFromRIFF(RIFF::RIFFReader & file);
+class ChunkReader;
+
+// A chunk's data in the file
+struct ChunkData {
+	std::span<const uint8_t> data;
+	bool compressed;	// Then data is a "cmpr" chunk's, read it with readChunk()
+};
+
+// Where a song's chunks are in the file, so that they can be decoded in any order
+struct SongChunks {
+	std::span<const uint8_t> effectColumns;
+	std::vector<ChunkData> notes;	// In file order, the patterns refer to them by index
+	std::vector<ChunkData> patterns;
+};
+
+SongChunks indexSong (ChunkReader & reader);
+
+/**
+ * @brief Finds a song's chunks from its table of contents entry, checking each against the file
+ * @param file The whole file, which the offsets are from
+ * @param songList The song's LIST chunk, every chunk has to be inside of it
+ * @return false if the entry doesn't match the file
+ */
+bool indexSong (std::span<const uint8_t> file, std::span<const uint8_t> songList, std::span<const uint8_t> entry, SongChunks & output);
+
+/**
+ * @brief Splits a "toc " chunk into the entries of every song
+ * @return The entries, by the offset of the song's LIST chunk
+ */
+std::unordered_map<size_t, std::span<const uint8_t>> readTableOfContents (std::span<const uint8_t> data);
+
+/**
+ * @brief Makes a "toc " chunk
+ * @param songsOffset Where the first song's LIST chunk will be in the file
+ * @param chunkSizes The data sizes of every song's chunks, in the order they'll be written
+ */
+std::vector<uint8_t> encodeTableOfContents (size_t songsOffset, const std::vector<std::vector<size_t>> & chunkSizes);
+
+// What lazily loaded songs are decoded from, shared by copies of the project
+struct LazySongs {
+	std::shared_ptr<const void> owner;		// Keeps the file's data alive
+	std::vector<SongChunks> songs;
+};
 
-std::vector<TrackerCell> decodeNoteStruct (const std::vector<uint8_t> chunkData);
-std::vector<uint8_t> encodeNoteStruct (const std::vector<TrackerCell> pattern);
+// Size of a chunk with its header and padding byte
+constexpr size_t chunkSize (size_t dataSize) { return 8 + dataSize + (dataSize & 1); }
+
+// Smaller chunks are never compressed, as there's too little to gain
+constexpr size_t COMPRESSION_THRESHOLD = 256;
+
+/**
+ * @brief Makes a chunk's data ready for saving, compressing it if it pays off
+ * @param id Of the chunk, kept in the compressed chunk
+ */
+Song::EncodedChunk storeChunk (const char * id, std::vector<uint8_t> && data);
+
+/**
+ * @brief Get a chunk's data, decompressing it if needed
+ * @param buffer Holds the decompressed data, which output then points to
+ * @return false if it doesn't decompress
+ */
+bool readChunk (const ChunkData & chunk, std::vector<uint8_t> & buffer, std::span<const uint8_t> & output);
+
+/**
+ * @brief Decodes songs on the job system, every note chunk being a separate piece of work
+ * @param output Gets the songs, in the same order as the indexes
+ */
+void loadSongs (const std::vector<SongChunks> & songs, std::vector<Song> & output);
+
+// Note chunks decoded per job by loadSongs()
+constexpr size_t NOTE_CHUNKS_PER_JOB = 16;
+// Note chunks encoded per job by saveRIFFFile(), fewer as encoding takes far longer
+constexpr size_t NOTE_CHUNKS_PER_ENCODE_JOB = 4;
+
+// Patterns longer than this are treated as corrupt data
+constexpr size_t MAX_PATTERN_ROWS = 1 << 20;
+
+struct DecodeResult {
+	enum Error : uint8_t {
+		NONE,
+		TRUNCATED,				// The data ends in the middle of a row
+		TOO_MANY_ROWS,			// Over MAX_PATTERN_ROWS
+		UNSUPPORTED_EFFECTS,	// Effect data, which can't be parsed yet
+		BAD_COMPRESSION,		// A "cmpr" chunk that doesn't decompress
+	} error;
+	size_t offset;		// Into the chunk data, where the decoding stopped
+	size_t rows;		// Rows decoded before that
+
+	explicit operator bool () const { return error != NONE; };
+	const char * toString () const;
+};
 
-TrackerPattern decodePatternStruct (const std::vector<uint8_t> chunkData);
-std::vector<uint8_t> encodePatternStruct (const TrackerPattern pattern);
+/**
+ * @brief Decodes a note chunk, checking every read against the end of the data
+ * @param output Gets the pattern, with the rows up to the error decoded if there is one
+ */
+DecodeResult decodeNoteStruct (std::span<const uint8_t> chunkData, PatternData & output);
+std::vector<uint8_t> encodeNoteStruct (const PatternData & pattern);
+
+DecodeResult decodePatternStruct (std::span<const uint8_t> chunkData, TrackerPattern & output);
+std::vector<uint8_t> encodePatternStruct (const TrackerPattern & pattern);
 
 
 // RIFF constants
@@ -168,8 +296,10 @@ const char thisBranch   [9]     = "Dev Main";
 
 
 // Chunk IDs
+const char riffId           [5]     = "RIFF";
 const char versionId        [5]     = "ver ";
 const char listId           [5]     = "LIST";
+const char tableOfContentsId[5]     = "toc ";
 // in "INFO"
 const char artistId         [5]     = "IART";
 const char commentsId       [5]     = "ICMT";
@@ -183,125 +313,184 @@ const char * const songNameId       = nameId;
 const char colorId          [5]     = "col ";
 const char noteId           [5]     = "note";
 const char patternId		[5]		= "ptrn";
+const char compressedId		[5]		= "cmpr";
 
 // List types
 const char infoListType		[5]		= "INFO";
 const char songListType		[5]		= "song";
 
 const uint32_t mainBranchVer = 0;
-const uint32_t thisBranchVer = 0;
+const uint32_t thisBranchVer = 1;		// The newest version read, files only need it if they have "cmpr" chunks
+
+#pragma region chunkReading
 
-#define ifEq(ptra, ptrb) if (!memcmp(ptra, ptrb, 4))
-#define ifNeq(ptra, ptrb) if (memcmp(ptra, ptrb, 4))
+// A chunk, pointing into the loaded file's memory
+struct Chunk {
+	const uint8_t * id;
+	std::span<const uint8_t> data;	// Without the header and the padding byte
 
-#define getID() file().c_id
-#define getType() file().ls[file().ls_level-1].c_type
+	bool is (const char * otherId) const { return !memcmp(id, otherId, 4); };
+	// For RIFF and LIST chunks, whose data starts with their type
+	bool isType (const char * type) const { return data.size() >= 4 && !memcmp(data.data(), type, 4); };
+	std::span<const uint8_t> children () const { return data.size() >= 4 ? data.subspan(4) : data.subspan(data.size()); };
+};
 
-#define ifID(ptr) ifEq(id, ptr)
-#define ifTp(ptr) ifEq(type, ptr)
+/*	Goes through the chunks laid out one after another in
+	a span, e.g. a LIST chunk's children(), without copying
+	anything. Uses libriff's error codes, so that the error
+	handling is the same as with RIFF::RIFFReader.
+*/
+class ChunkReader {
+	public:
+		ChunkReader (std::span<const uint8_t> data) : remaining(data) {};
+
+		/**
+		 * @brief Reads the next chunk's header
+		 * @return 0, RIFF_ERROR_EOCL once there are no more chunks, or RIFF_ERROR_ICSIZE if the chunk doesn't fit
+		 */
+		int next (Chunk & chunk) {
+			if (remaining.empty()) return RIFF_ERROR_EOCL;
+			if (remaining.size() < 8) return RIFF_ERROR_ICSIZE;
+			uint32_t size = BitConverter::readUint32(remaining.data() + 4);
+			if (size > remaining.size() - 8) return RIFF_ERROR_ICSIZE;
+			chunk.id = remaining.data();
+			chunk.data = remaining.subspan(8, size);
+			remaining = remaining.subspan(std::min(remaining.size(), 8 + (size_t)size + (size & 1)));
+			return 0;
+		};
+
+		static const char * errorToString (int errCode) {
+			switch (errCode) {
+				case 0:						return "";
+				case RIFF_ERROR_EOCL:		return "End of chunk list\n";
+				case RIFF_ERROR_ICSIZE:		return "Chunk size is larger than its parent, the file is truncated or corrupt\n";
+				default:					return "Unknown error\n";
+			}
+		};
 
+	private:
+		std::span<const uint8_t> remaining;
+};
 
-int loadRIFFFile (RIFF::RIFFReader & file, Project & project) {
-	project = Project();
+#pragma endregion
 
-	int errCode;
-	char *id, *type;
+int loadRIFFFile (std::span<const uint8_t> data, Project & project, std::shared_ptr<const void> owner) {
+	PROFILE_SCOPE("RIFFLoader::loadRIFFFile");
+	project = Project();
 
 	// 1. Test file type
-		ifNeq (file().h_type, fileType){
-			fprintf(stderr, "The file type is not a Genecyzer file. Aborting loading\n");
+		Chunk root;
+		ChunkReader fileReader(data);
+		if (fileReader.next(root) || !root.is(riffId) || !root.isType(fileType)) {
+			LOG_ERROR("The file type is not a Genecyzer file. Aborting loading\n");
 			return -1;
-		} 
-		auto chunkData = file.readChunkData();
-		auto data = chunkData.data();
-		auto size = chunkData.size();
-		printByteArray(data, size, 16);
+		}
+		ChunkReader reader(root.children());
+		std::vector<SongChunks> songs;
+		std::unordered_map<size_t, std::span<const uint8_t>> tableOfContents;
+		bool hasTableOfContents = false;
+
+		Chunk chunk;
+		int errCode = reader.next(chunk);
+		auto * version = chunk.data.data();
+		if (errCode || chunk.data.size() < 12) {
+			LOG_ERROR("File version is invalid. Aborting loading\n");
+			return -1;
+		}
+		LOG_BYTES(Log::Level::Trace, version, chunk.data.size());
 		if ( !(
-			(!memcmp(data, mainBranch, 8) && BitConverter::readUint32(data+8) <= mainBranchVer) || 
-			(!memcmp(data, thisBranch, 8) && BitConverter::readUint32(data+8) <= thisBranchVer)
+			(!memcmp(version, mainBranch, 8) && BitConverter::readUint32(version+8) <= mainBranchVer) || 
+			(!memcmp(version, thisBranch, 8) && BitConverter::readUint32(version+8) <= thisBranchVer)
 		) ) { 
-			fprintf(stderr, "File version is invalid. Aborting loading\n");
+			LOG_ERROR("File version is invalid. Aborting loading\n");
 			return -1;
 		}
-		errCode = file.seekNextChunk();
+		errCode = reader.next(chunk);
 
     // And now, read the rest of the file
     while (!errCode) {
-		id = getID();
-        ifID(listId){
+        if (chunk.is(listId)) {
             // LIST type, has several subtypes
-            errCode = file.seekLevelSub();
+            ChunkReader subReader(chunk.children());
 
-            auto * type = getType();
-
-            ifTp (infoListType) {
+            if (chunk.isType(infoListType)) {
 				// INFO subchunk
-				while (!errCode) {
-					chunkData = file.readChunkData();
+				Chunk info;
+				while (!(errCode = subReader.next(info))) {
+					LOG_BYTES(Log::Level::Trace, info.data.data(), info.data.size());
 
-					id = getID();
+					// Not necessarily null-terminated
+					std::string text((const char *)info.data.data(), strnlen((const char *)info.data.data(), info.data.size()));
 
-					ifID(commentsId) {
+					if (info.is(commentsId)) {
 					// Comment subsubchunk, gotta convert 'em
 					// record separator chars into newlines
-					for (auto &c : chunkData) {
+					for (auto &c : text) {
 						if (c == 0x1E)
 						c = 0x0A; // Record Separator -> LineFeed
 					}
 					}
 
-					printByteArray(chunkData.data(), chunkData.size(), 16);
-
-					if (chunkData.back() != 0)
-					chunkData.push_back(0);
-
-					ifID(nameId) project.name() =
-						std::string((char *)chunkData.data());
-					else ifID(artistId) project.composer() =
-						std::string((char *)chunkData.data());
-					else ifID(copyrightId) project.copyright() =
-						std::string((char *)chunkData.data());
-					else ifID(commentsId) project.comments() =
-						std::string((char *)chunkData.data());
-					else ifID(softwareId) {
-					if (!(chunkData.size() == 10 &&
-							!memcmp(chunkData.data(), software, 9)))
-						fprintf(stderr,
+					if (info.is(nameId)) project.name() = text;
+					else if (info.is(artistId)) project.composer() = text;
+					else if (info.is(copyrightId)) project.copyright() = text;
+					else if (info.is(commentsId)) project.comments() = text;
+					else if (info.is(softwareId)) {
+					if (!(info.data.size() == 10 &&
+							!memcmp(info.data.data(), software, 9)))
+						LOG_WARNING(
 								"The \"Software\" field in the Genecyzer file's "
 								"metadata is not set to \"Genecyzer\". This "
 								"indicates a file that has been created or "
 								"modified by external software, which could lead "
 								"to invalid file loading.\n");
 					}
-
-					errCode = file.seekNextChunk();
 				}
-				if (errCode != RIFF_ERROR_EOCL) {fprintf(stderr, "%s", file.errorToString(errCode).c_str());}
-            } else ifTp(songListType) {
-				project.songs.push_back(loadSongFromRIFF(file));
+				if (errCode != RIFF_ERROR_EOCL) {LOG_ERROR("%s", ChunkReader::errorToString(errCode));}
+            } else if (chunk.isType(songListType)) {
+				SongChunks song;
+				auto entry = tableOfContents.find(chunk.id - data.data());
+				std::span<const uint8_t> songList (chunk.id, chunk.data.data() + chunk.data.size());
+				if (entry == tableOfContents.end() || !indexSong(data, songList, entry->second, song)) {
+					// Still loads, but a table of contents written by Genecyzer should always match
+					if (hasTableOfContents)
+						LOG_WARNING("The table of contents doesn't match song %zu, reading its chunks one by one\n", songs.size());
+					song = indexSong(subReader);
+				}
+				songs.push_back(std::move(song));
 			}
-			errCode = file.levelParent(); if (errCode) {fprintf(stderr, "%s", file.errorToString(errCode).c_str());}
-			errCode = file.seekChunkStart(); if (errCode) {fprintf(stderr, "%s", file.errorToString(errCode).c_str());}
-
-        } 
+        } else if (chunk.is(tableOfContentsId)) {
+			tableOfContents = readTableOfContents(chunk.data);
+			hasTableOfContents = true;
+		}
 
-        errCode = file.seekNextChunk();
+        errCode = reader.next(chunk);
     }
+	if (errCode != RIFF_ERROR_EOCL) {LOG_ERROR("%s", ChunkReader::errorToString(errCode));}
 
-    printf("Name: %s\nComposer: %s\nCopyright:\n----\n%s\n----\nComments:\n----\n%s\n----\n", project.name().c_str(), project.composer().c_str(), project.copyright().c_str(), project.comments().c_str());
+	// Only now decode the songs, all at once, or just the first one if the rest can wait
+	if (owner && hasTableOfContents && songs.size() > 1) {
+		project.songs.resize(songs.size());
+		project.pendingSongs.assign(songs.size(), true);
+		project.lazySongs = std::make_shared<LazySongs>(LazySongs {std::move(owner), std::move(songs)});
+		project.song(0);
+	} else loadSongs(songs, project.songs);
+
+    LOG_DEBUG("Name: %s\nComposer: %s\nCopyright:\n----\n%s\n----\nComments:\n----\n%s\n----\n", project.name().c_str(), project.composer().c_str(), project.copyright().c_str(), project.comments().c_str());
 
 	return errCode == RIFF_ERROR_EOCL ? 0 : errCode;
 }
 
-int saveRIFFFile (RIFF::RIFFWriter & file, Project & project) {
-	// Write the version chunk
-	file.newChunk();
-	file.writeInChunk(thisBranch, 8);
-	file.writeInChunk(BitConverter::toByteArray(thisBranchVer).data(), 4);
-	file.finishChunk(versionId);    
+int saveRIFFFile (RIFF::RIFFWriter & file, const Project & project) {
+	PROFILE_SCOPE("RIFFLoader::saveRIFFFile");
+	// Everything is laid out before writing, the table of contents needs every chunk's offset
+	struct OutChunk {
+		const char * id;
+		std::span<const uint8_t> data;
+	};
 
-	// Write the INFO LIST chunk
-	file.newListChunk(infoListType);
+	// 1. The INFO LIST chunk
+	std::vector<std::pair<const char *, std::string>> info;
 	{
 		auto metadata = project.exportMetadata();
 		auto & name 		= metadata.name;
@@ -309,41 +498,116 @@ int saveRIFFFile (RIFF::RIFFWriter & file, Project & project) {
 		auto & copyright	= metadata.copyright;
 		auto & comments	= metadata.comments;
 
-		file.writeNewChunk(software, sizeof(software), softwareId);
+		info.emplace_back(softwareId, std::string(software, sizeof(software)));
 		if (composer.length())
-			file.writeNewChunk(composer.c_str(), composer.length(), artistId);
+			info.emplace_back(artistId, composer);
 		if (comments.length()) {
-			char * chunkData = new char[comments.length()];
-			std::strncpy(chunkData, comments.c_str(), comments.length());
-			for (size_t i = 0; i < comments.length(); i++) {
-				if (chunkData[i] == 0x0A) chunkData[i] = 0x1E; // LineFeed -> Record Separator
+			std::string chunkData = comments;
+			for (auto & c : chunkData) {
+				if (c == 0x0A) c = 0x1E; // LineFeed -> Record Separator
 			}
-			file.writeNewChunk(chunkData, comments.length(), commentsId);
-			delete[] chunkData;
+			info.emplace_back(commentsId, std::move(chunkData));
 		}
 		if (copyright.length())
-			file.writeNewChunk(copyright.c_str(), copyright.length(), copyrightId);
+			info.emplace_back(copyrightId, copyright);
 		if (name.length())
-			file.writeNewChunk(name.c_str(), name.length(), nameId);
+			info.emplace_back(nameId, name);
 	}
 
-	file.finishListChunk();
-
-	for (Song &song : project.songs) {
-		file.newListChunk(songListType);
+	// 2. The note chunks that changed since they were last saved or loaded, encoded on the job system.
+	//    Interned patterns are shared between channels and songs, so each is encoded once at most
+	std::unordered_map<const PatternData *, Song::EncodedChunk> encoded;
+	for (size_t i = 0; i < project.songs.size(); i++) {
+		if (!project.isSongLoaded(i)) continue;
+		const Song & song = project.songs[i];
+		for (size_t j = 0; j < song.patternData.size(); j++) {
+			if (song.patternData[j]->size() == 0) continue;
+			auto & entry = encoded[song.patternData[j].get()];
+			if (!entry) entry = song.cachedNoteChunk(j);
+		}
+	}
+	std::vector<std::pair<const PatternData *, Song::EncodedChunk>> toEncode;
+	for (auto & [pattern, data] : encoded)
+		if (!data) toEncode.emplace_back(pattern, nullptr);
+	auto group = JobSystem::createGroup();
+	JobSystem::parallelFor(group, 0, toEncode.size(), NOTE_CHUNKS_PER_ENCODE_JOB, [&](size_t i){
+		toEncode[i].second = storeChunk(noteId, encodeNoteStruct(*toEncode[i].first));
+	});
+	group->wait();
+	for (auto & [pattern, data] : toEncode) encoded[pattern] = std::move(data);
+
+	// 3. The songs, the ones not loaded yet as they are in the file
+	std::vector<std::vector<OutChunk>> songs(project.songs.size());
+
+	for (size_t i = 0; i < project.songs.size(); i++) {
+		auto & chunks = songs[i];
+		if (!project.isSongLoaded(i)) {
+			// Not decoded since loading, so it's still as it is in the file
+			auto & original = project.lazySongs->songs[i];
+			if (!original.effectColumns.empty()) chunks.push_back({effectColumnId, original.effectColumns});
+			for (auto & chunk : original.notes) chunks.push_back({chunk.compressed ? compressedId : noteId, chunk.data});
+			for (auto & chunk : original.patterns) chunks.push_back({chunk.compressed ? compressedId : patternId, chunk.data});
+			continue;
+		}
 
-			file.writeNewChunk(project.songs[0].effectColumnAmount.data(), 8, effectColumnId);
+		const Song & song = project.songs[i];
+		chunks.push_back({effectColumnId, {song.effectColumnAmount.data(), 8}});
 
-			for (auto &pattern : song.patternData) {
-				if (pattern.size() > 0) {
-					file.writeNewChunk(encodeNoteStruct(pattern), noteId);
-				}
+		for (size_t j = 0; j < song.patternData.size(); j++) {
+			auto & pattern = song.patternData[j];
+			if (pattern->size() == 0) continue;
+			auto data = song.cachedNoteChunk(j);
+			if (!data) {
+				data = encoded[pattern.get()];
+				song.cacheNoteChunk(j, data);
 			}
+			chunks.push_back({data->compressed ? compressedId : noteId, data->data});		// The song's cache keeps it alive
+		}
 
-			for (auto &pattern : song.patterns) {
-				file.writeNewChunk(encodePatternStruct(pattern), patternId);
+		for (size_t j = 0; j < song.patterns.size(); j++) {
+			auto data = song.cachedPatternChunk(j);
+			if (!data) {
+				data = storeChunk(patternId, encodePatternStruct(song.patterns[j]));
+				song.cachePatternChunk(j, data);
 			}
+			chunks.push_back({data->compressed ? compressedId : patternId, data->data});
+		}
+	}
+
+	// 4. The table of contents, the songs come right after it
+	size_t songsOffset = 12 + chunkSize(12) + 12;	// RIFF header and type, version chunk, INFO LIST header and type
+	for (auto & [id, text] : info) songsOffset += chunkSize(text.size());
+	std::vector<std::vector<size_t>> chunkSizes(songs.size());
+	size_t tableSize = 4;
+	for (size_t i = 0; i < songs.size(); i++) {
+		for (auto & chunk : songs[i]) chunkSizes[i].push_back(chunk.data.size());
+		tableSize += 8 + 8 * songs[i].size();
+	}
+	songsOffset += chunkSize(tableSize);
+	auto tableOfContents = encodeTableOfContents(songsOffset, chunkSizes);
+
+	// 5. Write it all, as the oldest version that has everything in it
+	uint32_t version = 0;
+	for (auto & chunks : songs)
+		for (auto & chunk : chunks)
+			if (!memcmp(chunk.id, compressedId, 4)) version = 1;
+
+	file.newChunk();
+	file.writeInChunk(thisBranch, 8);
+	file.writeInChunk(BitConverter::toByteArray(version).data(), 4);
+	file.finishChunk(versionId);    
 
+	file.newListChunk(infoListType);
+		for (auto & [id, text] : info)
+			file.writeNewChunk(text.data(), text.size(), id);
+	file.finishListChunk();
+
+	file.writeNewChunk(tableOfContents, tableOfContentsId);
+
+	for (auto & chunks : songs) {
+		file.newListChunk(songListType);
+			for (auto & chunk : chunks)
+				file.writeNewChunk(chunk.data.data(), chunk.data.size(), chunk.id);
 		file.finishListChunk();
 	}
 
@@ -352,36 +616,191 @@ int saveRIFFFile (RIFF::RIFFWriter & file, Project & project) {
 	return 0;
 }
 
-Song loadSongFromRIFF(RIFF::RIFFReader & file) {
-	char * id = getID();
-	char * type = getType();
-
-	Song song;
-
-	int errCode = 0;
-
-	while (!errCode) {
-		id = getID();
-		ifID (effectColumnId) {
-			auto data = file.readChunkData();
-			if (data.size() != 8) {err ("RLoad:LSong: EFFC RCD SIZE\n");}
-			else memcpy(&song.effectColumnAmount, data.data(), 8);	// Is endian-safe cuz 1 byte
-		} else ifID (noteId) {
-			auto data = file.readChunkData();
-			if (data.size() < 4) {err ("RLoad:LSong: NOTE RCD SIZE\n");}
-			else song.patternData.push_back(decodeNoteStruct(data));
-		} else ifID (patternId) {
-			auto data = file.readChunkData();
-			if (data.size() < 2*sizeof(uint16_t)+2*VAR16_MIN_SIZE+sizeof(uint32_t)) {err ("RLoad:LSong: PTRN RCD SIZE\n");}
-			else song.patterns.push_back(decodePatternStruct(data));
-		}
+SongChunks indexSong (ChunkReader & reader) {
+	SongChunks song;
+	Chunk chunk;
 
-		errCode = file.seekNextChunk();
+	int errCode;
+	while (!(errCode = reader.next(chunk))) {
+		if (chunk.is(effectColumnId)) song.effectColumns = chunk.data;
+		else if (chunk.is(noteId)) song.notes.push_back({chunk.data, false});
+		else if (chunk.is(patternId)) song.patterns.push_back({chunk.data, false});
+		else if (chunk.is(compressedId) && chunk.data.size() >= 8) {
+			if (!memcmp(chunk.data.data(), noteId, 4)) song.notes.push_back({chunk.data, true});
+			else if (!memcmp(chunk.data.data(), patternId, 4)) song.patterns.push_back({chunk.data, true});
+		}
 	};
-	if (errCode != RIFF_ERROR_EOCL) {fprintf(stderr, "%s", file.errorToString(errCode).c_str());}
+	if (errCode != RIFF_ERROR_EOCL) {LOG_ERROR("%s", ChunkReader::errorToString(errCode));}
 
 	return song;
-};
+}
+
+bool indexSong (std::span<const uint8_t> file, std::span<const uint8_t> songList, std::span<const uint8_t> entry, SongChunks & output) {
+	output = SongChunks();
+	if (entry.size() < 4) return false;
+	uint32_t count = BitConverter::readUint32(entry.data());
+	if (count > (entry.size() - 4) / 8) return false;
+
+	// The first 12 bytes are the LIST chunk's header and type
+	const uint8_t * start = songList.data() + 12, * end = songList.data() + songList.size();
+	for (size_t i = 0; i < count; i++) {
+		size_t offset = BitConverter::readUint32(entry.data() + 4 + i*8);
+		size_t length = BitConverter::readUint32(entry.data() + 8 + i*8);
+		if (offset < 8 || offset > file.size() || length > file.size() - offset) return false;
+		const uint8_t * header = file.data() + offset - 8;
+		if (header < start || header + 8 + length > end || BitConverter::readUint32(header + 4) != length) return false;
+
+		std::span<const uint8_t> data (header + 8, length);
+		if (!memcmp(header, effectColumnId, 4)) output.effectColumns = data;
+		else if (!memcmp(header, noteId, 4)) output.notes.push_back({data, false});
+		else if (!memcmp(header, patternId, 4)) output.patterns.push_back({data, false});
+		else if (!memcmp(header, compressedId, 4) && length >= 8 && !memcmp(data.data(), noteId, 4)) output.notes.push_back({data, true});
+		else if (!memcmp(header, compressedId, 4) && length >= 8 && !memcmp(data.data(), patternId, 4)) output.patterns.push_back({data, true});
+		else return false;
+	}
+	return true;
+}
+
+std::unordered_map<size_t, std::span<const uint8_t>> readTableOfContents (std::span<const uint8_t> data) {
+	std::unordered_map<size_t, std::span<const uint8_t>> output;
+	if (data.size() < 4) return output;
+	uint32_t songs = BitConverter::readUint32(data.data());
+	size_t position = 4;
+	for (uint32_t i = 0; i < songs && data.size() - position >= 8; i++) {
+		size_t offset = BitConverter::readUint32(data.data() + position);
+		size_t count = BitConverter::readUint32(data.data() + position + 4);
+		if (count > (data.size() - position - 8) / 8) break;
+		// The entry starts at the chunk count, which is what indexSong() wants
+		output[offset] = data.subspan(position + 4, 4 + count * 8);
+		position += 8 + count * 8;
+	}
+	return output;
+}
+
+std::vector<uint8_t> encodeTableOfContents (size_t songsOffset, const std::vector<std::vector<size_t>> & chunkSizes) {
+	std::vector<uint8_t> output;
+	output += BitConverter::toByteArray((uint32_t)chunkSizes.size());
+	size_t offset = songsOffset;
+	for (auto & sizes : chunkSizes) {
+		output += BitConverter::toByteArray((uint32_t)offset);
+		output += BitConverter::toByteArray((uint32_t)sizes.size());
+		size_t position = offset + 12;	// After the LIST chunk's header and type
+		for (auto size : sizes) {
+			output += BitConverter::toByteArray((uint32_t)(position + 8));
+			output += BitConverter::toByteArray((uint32_t)size);
+			position += chunkSize(size);
+		}
+		offset = position;
+	}
+	return output;
+}
+
+Song::EncodedChunk storeChunk (const char * id, std::vector<uint8_t> && data) {
+	if (data.size() >= COMPRESSION_THRESHOLD) {
+		auto compressed = LZ::compress(data);
+		if (compressed.size() + 8 < data.size()) {
+			std::vector<uint8_t> wrapped(id, id + 4);
+			wrapped += BitConverter::toByteArray((uint32_t)data.size());
+			wrapped.insert(wrapped.end(), compressed.begin(), compressed.end());
+			return std::make_shared<const Song::StoredChunk>(Song::StoredChunk {std::move(wrapped), true});
+		}
+	}
+	return std::make_shared<const Song::StoredChunk>(Song::StoredChunk {std::move(data), false});
+}
+
+bool readChunk (const ChunkData & chunk, std::vector<uint8_t> & buffer, std::span<const uint8_t> & output) {
+	if (!chunk.compressed) {
+		output = chunk.data;
+		return true;
+	}
+	if (chunk.data.size() < 8) return false;
+	uint32_t size = BitConverter::readUint32(chunk.data.data() + 4);
+	// Every byte of compressed data makes 255 bytes at most, anything more is corrupt
+	if (size / 255 > chunk.data.size()) return false;
+	buffer.resize(size);
+	if (!LZ::decompress(chunk.data.subspan(8), buffer)) return false;
+	output = buffer;
+	return true;
+}
+
+void loadSongs (const std::vector<SongChunks> & songs, std::vector<Song> & output) {
+	PROFILE_SCOPE("RIFFLoader::loadSongs");
+
+	// Every note chunk gets its own slot, so the jobs don't have to synchronize
+	struct DecodedSong {
+		std::vector<PatternData> notes;
+		std::vector<DecodeResult> noteResults, patternResults;
+	};
+	std::vector<DecodedSong> decoded(songs.size());
+	std::vector<std::pair<size_t, size_t>> noteChunks;	// Song and note index
+	for (size_t i = 0; i < songs.size(); i++) {
+		decoded[i].notes.resize(songs[i].notes.size());
+		decoded[i].noteResults.resize(songs[i].notes.size());
+		decoded[i].patternResults.resize(songs[i].patterns.size());
+		for (size_t note = 0; note < songs[i].notes.size(); note++)
+			noteChunks.emplace_back(i, note);
+	}
+	output.clear();
+	output.resize(songs.size());
+
+	// 1. Decode the note chunks of every song at once
+	auto group = JobSystem::createGroup();
+	JobSystem::parallelFor(group, 0, noteChunks.size(), NOTE_CHUNKS_PER_JOB, [&](size_t i){
+		auto [song, note] = noteChunks[i];
+		thread_local std::vector<uint8_t> buffer;
+		std::span<const uint8_t> data;
+		if (readChunk(songs[song].notes[note], buffer, data))
+			decoded[song].noteResults[note] = decodeNoteStruct(data, decoded[song].notes[note]);
+		else decoded[song].noteResults[note] = DecodeResult {DecodeResult::BAD_COMPRESSION, 0, 0};
+	});
+	group->wait();
+
+	// 2. Put every song together, in parallel too as interning hashes every pattern
+	JobSystem::parallelFor(group, 0, songs.size(), 1, [&](size_t i){
+		Song & song = output[i];
+		if (songs[i].effectColumns.size() == 8)
+			memcpy(&song.effectColumnAmount, songs[i].effectColumns.data(), 8);	// Is endian-safe cuz 1 byte
+
+		// Kept even if broken, the patterns refer to the note chunks by index
+		for (auto & pattern : decoded[i].notes) song.addPattern(std::move(pattern));
+
+		for (size_t j = 0; j < songs[i].patterns.size(); j++) {
+			TrackerPattern pattern;
+			std::vector<uint8_t> buffer;
+			std::span<const uint8_t> data;
+			if (readChunk(songs[i].patterns[j], buffer, data))
+				decoded[i].patternResults[j] = decodePatternStruct(data, pattern);
+			else decoded[i].patternResults[j] = DecodeResult {DecodeResult::BAD_COMPRESSION, 0, 0};
+			if (!decoded[i].patternResults[j]) song.patterns.push_back(std::move(pattern));
+		}
+
+		song.fitEffectCapacities();
+		song.internPatterns();
+
+		// What's in the file is as good as anything encodeNoteStruct() would make, saving can use it as is.
+		// The note chunks that failed to decode too: re-encoding what could be decoded of them would
+		// drop the rest, so they're written back byte for byte until edited
+		auto stored = [](const ChunkData & chunk) {
+			return std::make_shared<const Song::StoredChunk>(Song::StoredChunk {{chunk.data.begin(), chunk.data.end()}, chunk.compressed});
+		};
+		for (size_t j = 0; j < songs[i].notes.size(); j++)
+			song.cacheNoteChunk(j, stored(songs[i].notes[j]));
+		for (size_t j = 0, next = 0; j < songs[i].patterns.size(); j++)
+			if (!decoded[i].patternResults[j]) song.cachePatternChunk(next++, stored(songs[i].patterns[j]));
+	});
+	group->wait();
+
+	// 3. Report the errors, in file order
+	for (size_t i = 0; i < songs.size(); i++) {
+		if (!songs[i].effectColumns.empty() && songs[i].effectColumns.size() != 8) {err ("RLoad:LSong: EFFC RCD SIZE\n");}
+		for (size_t j = 0; j < decoded[i].noteResults.size(); j++)
+			if (auto & result = decoded[i].noteResults[j])
+				err ("RLoad:LSong: NOTE %zu: %s at byte %zu (row %zu)\n", j, result.toString(), result.offset, result.rows);
+		for (size_t j = 0; j < decoded[i].patternResults.size(); j++)
+			if (auto & result = decoded[i].patternResults[j])
+				err ("RLoad:LSong: PTRN %zu: %s at byte %zu\n", j, result.toString(), result.offset);
+	}
+}
 
 
 constexpr uint8_t REPEAT_DEFAULT_CELL = 253;
@@ -394,35 +813,56 @@ constexpr uint8_t NOTE_REPEAT = 3;
 constexpr uint8_t INST_REPEAT = 2;
 constexpr uint8_t FLAG_REPEAT = 1;
 
-std::vector<TrackerCell> decodeNoteStruct (std::vector<uint8_t> chunkData) {
-	// Accepts chunk data directly from RIFF::RIFFReader::ReadChunkData()
-	uint8_t * ptr = chunkData.data();	// Might seem unnecessary, but this will prevent segfaults
-	
+const char * DecodeResult::toString () const {
+	switch (error) {
+		case NONE:					return "no error";
+		case TRUNCATED:				return "data ends early";
+		case TOO_MANY_ROWS:			return "row count is over MAX_PATTERN_ROWS";
+		case UNSUPPORTED_EFFECTS:	return "effects are not supported yet";
+		case BAD_COMPRESSION:		return "compressed data is corrupt";
+		default:					return "unknown error";
+	}
+}
+
+DecodeResult decodeNoteStruct (std::span<const uint8_t> chunkData, PatternData & output) {
+	// Accepts chunk data straight from the file's memory
+	const uint8_t * ptr = chunkData.data();
+	const uint8_t * endPtr = chunkData.data()+chunkData.size();
+	size_t row = 0;
+
+	auto fail = [&](DecodeResult::Error error) { return DecodeResult {error, (size_t)(ptr - chunkData.data()), row}; };
+	auto readByte = [&](uint8_t & value) {
+		if (ptr >= endPtr) return false;
+		value = *ptr++;
+		return true;
+	};
+
+	output = PatternData();
+	if (chunkData.size() < sizeof(uint32_t)) return fail(DecodeResult::TRUNCATED);
 	uint32_t count = BitConverter::readUint32(ptr);
-	if (count == 0) return std::vector<TrackerCell>(0);
 	ptr += sizeof(count);
-	
+	if (count > MAX_PATTERN_ROWS) return fail(DecodeResult::TOO_MANY_ROWS);
+
+	// Every row that is not a repeat takes at least 2 bytes, so that many events at most
+	output.resize(count);
+	output.reserve(std::min((size_t)count, (size_t)(endPtr - ptr) / 2 + 1));
+
 	uint16_t noteRptCount = 0, instRptCount = 0, flagRptCount = 0;
-	uint8_t noteRpt, instRpt, flagRpt;
+	uint8_t noteRpt = 0, instRpt = 0, flagRpt = 0;
 	
-	uint8_t * endPtr = chunkData.data()+chunkData.size();
 	TrackerCell cell, defaultCell;
-	std::vector<TrackerCell> array;
 
-	for (int i = count; ptr <= endPtr && i != 0; i--) {
+	for (; row < count; row++) {
 		// 1. Parse (or repeat) the note byte
 		uint8_t noteValue;
 
 		if (noteRptCount != 0) {
 			noteRptCount--;
 			noteValue = noteRpt;
-		} else {
-			noteValue = *ptr;
-			ptr++;
-		}
+		} else if (!readByte(noteValue)) return fail(DecodeResult::TRUNCATED);
 
 		if (noteValue == REPEAT_DEFAULT_CELL) {
-			array.push_back(defaultCell);
+			output.setCell(row, defaultCell);
 			continue;
 		} else if (noteValue >= 0 && noteValue <= TrackerCell::MAX_NOTE ||
 			noteValue == TrackerCell::EMPTY_NOTE ||
@@ -433,10 +873,7 @@ std::vector<TrackerCell> decodeNoteStruct (std::vector<uint8_t> chunkData) {
 		if (flagRptCount != 0) {
 			flagRptCount--;
 			flagsByte = flagRpt;
-		} else {
-			flagsByte = *ptr;
-			ptr++;
-		}
+		} else if (!readByte(flagsByte)) return fail(DecodeResult::TRUNCATED);
 
 		cell.attack((flagsByte & 1<<ATTACK) != 0);	// 3. Set attack
 		if (flagsByte & 1<<INSTRUMENT) {
@@ -444,16 +881,15 @@ std::vector<TrackerCell> decodeNoteStruct (std::vector<uint8_t> chunkData) {
 			if (instRptCount != 0) {
 				instRptCount--;
 				cell.instrument = instRpt;
-			} else {
-				cell.instrument = *ptr;
-				ptr++;
-			}
+			} else if (!readByte(cell.instrument)) return fail(DecodeResult::TRUNCATED);
 			cell.hideInstrument(false);
-		} else cell.hideInstrument(true);
+		} else {
+			cell.hideInstrument(true);
+			cell.instrument = PatternData::EMPTY_CELL.instrument;
+		}
 		if (flagsByte & 1<<EFFECTS) {
-			// 5. Effects
-			// ptr++;
-			err ("No FX support rn\n");
+			// 5. Effects, the rest can't be parsed without knowing their size
+			return fail(DecodeResult::UNSUPPORTED_EFFECTS);
 		}
 		if (flagsByte & 1<<SET_DEFAULT) {
 			// 6. Set it as the default cell
@@ -464,136 +900,390 @@ std::vector<TrackerCell> decodeNoteStruct (std::vector<uint8_t> chunkData) {
 		if (flagsByte & 1<<NOTE_REPEAT) {
 			// 7.1. Note repeating
 			noteRpt = noteValue;
-			noteRptCount = Var16::readBytes(ptr);
+			if (!Var16::readBytes(ptr, endPtr, noteRptCount)) return fail(DecodeResult::TRUNCATED);
 		}
 		if (flagsByte & 1<<INST_REPEAT) {
 			// 7.2. Instrument repeating
 			instRpt = cell.instrument;
-			instRptCount = Var16::readBytes(ptr);
+			if (!Var16::readBytes(ptr, endPtr, instRptCount)) return fail(DecodeResult::TRUNCATED);
 		}
 		if (flagsByte & 1<<FLAG_REPEAT) {
 			// 7.3. Flag byte repeating
 			flagRpt = flagsByte;
 			flagRpt &= ~((1<<NOTE_REPEAT)|(1<<INST_REPEAT)|(1<<FLAG_REPEAT)); 	// Repeating this would break shit
-			flagRptCount = Var16::readBytes(ptr);
-
+			if (!Var16::readBytes(ptr, endPtr, flagRptCount)) return fail(DecodeResult::TRUNCATED);
 		}
 
-		array.push_back(cell);
+		output.setCell(row, cell);
 	}
 
-	return array;
+	return DecodeResult {DecodeResult::NONE, (size_t)(ptr - chunkData.data()), row};
+}
+
+#pragma region noteStructEncoder
+
+/*	The encoder chooses, for every row, whether to repeat
+	the default cell or write the row out, which written rows
+	become the default cell, and where to start note,
+	instrument and flag repeats. That's a shortest path over
+	the rows, where the state is what the decoder carries
+	from one row to the next:
+		- the default cell, out of the empty cell and the
+		  MAX_DEFAULT_CELLS most common cells,
+		- whether a note repeat can cover the row,
+		- whether an instrument repeat can cover the next
+		  row with an instrument,
+		- which flag byte a flag repeat would give the next
+		  written row, if one is running,
+	and each transition costs the bytes the row takes.
+	Repeats that could cover a row always do, a repeat that
+	would cover nothing is never started, and flag repeats
+	never include SET_DEFAULT, which keeps the state small
+	enough to go through every pattern on save.
+
+	Repeat counts are taken as 1 byte, so a count of 192 or
+	more costs the one byte more than planned. Repeats don't
+	cross BLOCK_ROWS boundaries, which keeps the counts in
+	Var16 range and the backtracking table bounded; the
+	default cell carries over from the cheapest end state of
+	the previous block.
+*/
+
+namespace NoteStructEncoder {
+
+constexpr size_t MAX_DEFAULT_CELLS = 8;		// Besides the empty cell
+constexpr size_t BLOCK_ROWS = 4096;
+
+constexpr size_t RUN_STATES = 2 * 2 * 5;	// Note repeat, instrument repeat, flag repeat (none or one of 4 flag bytes)
+constexpr uint32_t NO_COST = UINT32_MAX;
+constexpr uint32_t NO_INSTRUMENT = 0x100;
+
+// Decision bits, above the 8 bits of the previous state
+constexpr uint32_t DEFAULT_ROW	= 1<<8;
+constexpr uint32_t SETS_DEFAULT	= 1<<9;
+constexpr uint32_t NOTE_COVERED	= 1<<10;
+constexpr uint32_t INST_COVERED	= 1<<11;
+constexpr uint32_t FLAG_COVERED	= 1<<12;
+constexpr uint32_t NOTE_START	= 1<<13;
+constexpr uint32_t INST_START	= 1<<14;
+constexpr uint32_t FLAG_START	= 1<<15;
+
+// A cell as the note struct stores it: note | flag byte << 8 | instrument << 16
+inline uint32_t keyOf (uint8_t noteValue, uint8_t instrument, uint8_t cellFlags) {
+	bool hidden = cellFlags & TrackerCell::HIDE_INSTRUMENT_FLAG;
+	uint8_t flagsByte = (cellFlags & TrackerCell::ATTACK_FLAG ? 1<<ATTACK : 0) | (hidden ? 0 : 1<<INSTRUMENT);
+	return noteValue | flagsByte << 8 | (hidden ? 0 : instrument) << 16;
+}
+
+inline uint32_t keyOf (const TrackerCell & cell) {
+	return keyOf(cell.noteValue, cell.instrument,
+		(cell.attack() ? TrackerCell::ATTACK_FLAG : 0) | (cell.hideInstrument() ? TrackerCell::HIDE_INSTRUMENT_FLAG : 0));
 }
 
-std::vector<uint8_t> encodeNoteStruct (std::vector<TrackerCell> pattern) {
-	// Accepts chunk data directly from RIFF::RIFFReader::ReadChunkData()
-	std::unordered_map<TrackerCell, int> cellUsage;	// For determining the best default cell
+inline uint8_t noteOf (uint32_t key) { return key & 0xFF; }
+inline uint8_t flagsOf (uint32_t key) { return (key >> 8) & 0xFF; }
+inline uint8_t instrumentOf (uint32_t key) { return key >> 16; }
+inline bool hasInstrument (uint32_t key) { return flagsOf(key) & 1<<INSTRUMENT; }
+
+// Flag repeat state of a flag byte, 1..4
+inline uint32_t flagState (uint8_t flagsByte) { return 1 + ((flagsByte >> ATTACK) & 1) + ((flagsByte >> INSTRUMENT) & 1) * 2; }
+
+inline uint32_t state (uint32_t defaultCell, bool note, bool instrument, uint32_t flag) {
+	return defaultCell * RUN_STATES + note + instrument * 2 + flag * 4;
+}
+
+}	// namespace NoteStructEncoder
+
+std::vector<uint8_t> encodeNoteStruct (const PatternData & pattern) {
+	using namespace NoteStructEncoder;
 
 	auto array = BitConverter::toVector((uint32_t)pattern.size());
-	if (pattern.size() == 0) {return array;}
-	
-	for (auto & cell : pattern) {
-		if (cellUsage.count(cell) == 0) 
-				cellUsage[cell] = 0;
-		else	cellUsage[cell]++;
+	const size_t rows = pattern.size();
+	if (rows == 0) {return array;}
+
+	// 1. Reduce the rows to what gets stored of them (effects can't be yet)
+	const uint32_t emptyKey = keyOf(PatternData::EMPTY_CELL);
+	std::vector<uint32_t> keys(rows, emptyKey);
+	pattern.forEachEvent([&](const PatternData::Row & row){
+		keys[row.row] = keyOf(row.noteValue, row.instrument, row.flags);
+	});
+
+	// 2. Pick the candidates for the default cell, the decoder starts with the empty one
+	std::vector<uint32_t> candidates {emptyKey};
+	{
+		std::unordered_map<uint32_t, size_t> usage;
+		for (auto key : keys) usage[key]++;
+		std::vector<std::pair<size_t, uint32_t>> common;
+		for (auto & [key, count] : usage)
+			if (key != emptyKey && count >= 2) common.emplace_back(count, key);
+		size_t amount = std::min(common.size(), MAX_DEFAULT_CELLS);
+		std::partial_sort(common.begin(), common.begin() + amount, common.end(), std::greater<>());
+		for (size_t i = 0; i < amount; i++) candidates.push_back(common[i].second);
+	}
+	std::vector<int8_t> candidate(rows);
+	for (size_t row = 0; row < rows; row++) {
+		auto found = std::find(candidates.begin(), candidates.end(), keys[row]);
+		candidate[row] = found == candidates.end() ? -1 : found - candidates.begin();
+	}
+
+	// 3. The instrument of the previous row with one, and whether the next row with one has the same
+	std::vector<uint16_t> previousInstrument(rows);
+	std::vector<bool> instrumentFollows(rows);
+	for (size_t row = 0, last = NO_INSTRUMENT; row < rows; row++) {
+		previousInstrument[row] = last;
+		if (hasInstrument(keys[row])) last = instrumentOf(keys[row]);
+	}
+	for (size_t row = rows, next = NO_INSTRUMENT; row-- > 0;) {
+		if ((row + 1) % BLOCK_ROWS == 0) next = NO_INSTRUMENT;
+		instrumentFollows[row] = hasInstrument(keys[row]) && next == instrumentOf(keys[row]);
+		if (hasInstrument(keys[row])) next = instrumentOf(keys[row]);
 	}
 
-	int max = 0;
-	std::vector<TrackerCell> defaultCells;
+	// 4. Find the cheapest decisions, block by block
+	const size_t states = candidates.size() * RUN_STATES;
+	std::vector<uint32_t> cost(states), nextCost(states);
+	std::vector<uint32_t> choices(std::min(rows, BLOCK_ROWS) * states);
+	std::vector<uint16_t> decisions(rows);
+	uint32_t defaultCell = 0;
+
+	for (size_t blockStart = 0; blockStart < rows; blockStart += BLOCK_ROWS) {
+		size_t blockEnd = std::min(rows, blockStart + BLOCK_ROWS);
+		std::fill(cost.begin(), cost.end(), NO_COST);
+		cost[state(defaultCell, false, false, 0)] = 0;
+
+		for (size_t row = blockStart; row < blockEnd; row++) {
+			const uint32_t key = keys[row];
+			const bool instrument = hasInstrument(key);
+			const int8_t rowCandidate = candidate[row];
+			const uint32_t rowFlags = flagState(flagsOf(key));
+			const bool noteFollows = row + 1 < blockEnd && noteOf(keys[row + 1]) == noteOf(key);
+			const bool sameNote = row > blockStart && noteOf(keys[row - 1]) == noteOf(key);
+			const bool sameInstrument = instrument && previousInstrument[row] == instrumentOf(key);
+			uint32_t * rowChoices = &choices[(row - blockStart) * states];
+
+			std::fill(nextCost.begin(), nextCost.end(), NO_COST);
+			auto relax = [&](uint32_t to, uint32_t total, uint32_t decision) {
+				if (total < nextCost[to]) {
+					nextCost[to] = total;
+					rowChoices[to] = decision;
+				}
+			};
+
+			for (uint32_t from = 0; from < states; from++) {
+				if (cost[from] == NO_COST) continue;
+				const uint32_t current = from / RUN_STATES;
+				const uint32_t run = from % RUN_STATES;
+				const bool noteOpen = run & 1, instOpen = run & 2;
+				const uint32_t flagRun = run / 4;
+
+				// Repeating the default cell
+				if (rowCandidate == (int)current)
+					relax(state(current, false, instrument ? instOpen && sameInstrument : instOpen, flagRun),
+						cost[from] + 1, from | DEFAULT_ROW);
+
+				// Writing the row out
+				const bool noteCovered = noteOpen && sameNote;
+				const bool instCovered = instOpen && sameInstrument;
+				const uint32_t base = cost[from] + !noteCovered + (instrument && !instCovered);
+				const bool instAfter = instrument ? instCovered : instOpen;
+				const uint32_t covered = (noteCovered ? NOTE_COVERED : 0) | (instCovered ? INST_COVERED : 0);
+
+				if (flagRun == rowFlags)
+					relax(state(current, noteCovered, instAfter, flagRun), base, from | covered | FLAG_COVERED);
+
+				for (int setDefault = 0; setDefault < 2; setDefault++) {
+					if (setDefault && (rowCandidate < 0 || rowCandidate == (int)current)) continue;
+					const uint32_t next = setDefault ? rowCandidate : current;
+					for (int startNote = 0; startNote <= (noteFollows && !noteCovered); startNote++)
+					for (int startInst = 0; startInst <= (instrumentFollows[row] && !instCovered); startInst++)
+					for (int startFlag = 0; startFlag <= !setDefault; startFlag++)
+						relax(state(next, noteCovered || startNote, instrument ? instCovered || startInst : instOpen, startFlag ? rowFlags : 0),
+							base + 1 + startNote + startInst + startFlag,
+							from | covered | (setDefault ? SETS_DEFAULT : 0) |
+							(startNote ? NOTE_START : 0) | (startInst ? INST_START : 0) | (startFlag ? FLAG_START : 0));
+				}
+			}
+			std::swap(cost, nextCost);
+		}
 
-	for (auto & value : cellUsage) {
-		if (value.second > max) {
-			defaultCells.clear();
-			defaultCells.push_back(value.first);
-			max = value.second;
-		} else if (value.second == max) {
-			defaultCells.push_back(value.first);
+		// Backtrack from the cheapest end state
+		uint32_t at = std::min_element(cost.begin(), cost.end()) - cost.begin();
+		defaultCell = at / RUN_STATES;
+		for (size_t row = blockEnd; row-- > blockStart;) {
+			uint32_t choice = choices[(row - blockStart) * states + at];
+			decisions[row] = choice >> 8;
+			at = choice & 0xFF;
 		}
 	}
 
-	TrackerCell currentDefaultCell;
-	uint8_t tmp_flags;
-
-	for (auto & cell : pattern) {
-		tmp_flags = 0;
-		if (cell == (TrackerCell)defaultCells[0]){// TODO: handle this ([0]) better
-			if (cell != currentDefaultCell){
-				tmp_flags |= 1<<SET_DEFAULT;
-				currentDefaultCell = cell;
-			} else {
-				array.push_back(REPEAT_DEFAULT_CELL);
-				continue;
-			}
-		}	
-		array.push_back(cell.noteValue);
-		array.push_back(
-			(cell.attack() 			? 1<<ATTACK : 0		) |
-			(cell.hideInstrument()	? 0 : 1<<INSTRUMENT	) |
-			tmp_flags
-		);
-		if (!cell.hideInstrument()) 
-			array.push_back(cell.instrument);
+	// 5. Count how many rows each repeat covers, from the end
+	std::vector<uint16_t> noteCounts(rows), instCounts(rows), flagCounts(rows);
+	for (size_t row = rows, noteRun = 0, instRun = 0, flagRun = 0; row-- > 0;) {
+		uint32_t decision = decisions[row] << 8;
+		noteCounts[row] = noteRun;
+		instCounts[row] = instRun;
+		flagCounts[row] = flagRun;
+
+		noteRun = decision & NOTE_COVERED ? noteRun + 1 : 0;
+		if (hasInstrument(keys[row])) {
+			if (decision & INST_COVERED) instRun++;
+			else if (!(decision & DEFAULT_ROW) || previousInstrument[row] != instrumentOf(keys[row])) instRun = 0;
+		}
+		if (!(decision & DEFAULT_ROW)) flagRun = decision & FLAG_COVERED ? flagRun + 1 : 0;
 	}
 
-	//TODO COMPRESSION AGLORITHM
+	// 6. Write it all out
+	array.reserve(array.size() + rows * 2);
+	for (size_t row = 0; row < rows; row++) {
+		uint32_t decision = decisions[row] << 8;
+		uint32_t key = keys[row];
+		if (decision & DEFAULT_ROW) {
+			array.push_back(REPEAT_DEFAULT_CELL);
+			continue;
+		}
+		if (!(decision & NOTE_COVERED)) array.push_back(noteOf(key));
+		if (!(decision & FLAG_COVERED)) array.push_back(flagsOf(key) |
+			(decision & SETS_DEFAULT	? 1<<SET_DEFAULT : 0) |
+			(decision & NOTE_START		? 1<<NOTE_REPEAT : 0) |
+			(decision & INST_START		? 1<<INST_REPEAT : 0) |
+			(decision & FLAG_START		? 1<<FLAG_REPEAT : 0)
+		);
+		if (hasInstrument(key) && !(decision & INST_COVERED)) array.push_back(instrumentOf(key));
+		if (decision & NOTE_START) array += Var16::encode(noteCounts[row]);
+		if (decision & INST_START) array += Var16::encode(instCounts[row]);
+		if (decision & FLAG_START) array += Var16::encode(flagCounts[row]);
+	}
 
 	return array;
 }
 
-TrackerPattern decodePatternStruct (std::vector<uint8_t> chunkData) {
-	TrackerPattern pattern;
+#pragma endregion
 
-	auto * ptr = chunkData.data();	// Might seem unnecessary, but this will prevent segfaults
+DecodeResult decodePatternStruct (std::span<const uint8_t> chunkData, TrackerPattern & pattern) {
+	const uint8_t * ptr = chunkData.data();
+	const uint8_t * endPtr = chunkData.data()+chunkData.size();
+	auto fail = [&]() { return DecodeResult {DecodeResult::TRUNCATED, (size_t)(ptr - chunkData.data()), 0}; };
+
+	pattern = TrackerPattern();
 
 	// Get amount of rows
+	if (endPtr - ptr < (ptrdiff_t)(sizeof(uint32_t) + 8*sizeof(uint16_t))) return fail();
 	pattern.rows = BitConverter::readUint32(ptr);
 	ptr += sizeof(uint32_t);
 
 	// Get the rows
-	for (size_t i = 0; i < 8; i++, ptr += sizeof(uint16_t))
-		pattern.cells[i] = BitConverter::readUint16(ptr);
-
-	// Major beats
-	auto count = Var16::readBytes(ptr);
-	pattern.beats_major = std::vector<uint16_t> (count);
-	for (size_t i = 0; i < count; i++, ptr += sizeof(uint16_t))
-		pattern.beats_major[i] = BitConverter::readUint16(ptr);
-
-	// Minor beats
-	count = Var16::readBytes(ptr);
-	pattern.beats_minor = std::vector<uint16_t> (count);
-	for (size_t i = 0; i < count; i++, ptr += sizeof(uint16_t))
-		pattern.beats_minor[i] = BitConverter::readUint16(ptr);
+	BitConverter::readArray(ptr, std::span(pattern.cells));
+	ptr += sizeof(pattern.cells);
+
+	// Major and minor beats
+	for (auto * beats : {&pattern.beats_major, &pattern.beats_minor}) {
+		uint16_t count;
+		if (!Var16::readBytes(ptr, endPtr, count) || endPtr - ptr < (ptrdiff_t)(count * sizeof(uint16_t))) return fail();
+		beats->resize(count);
+		BitConverter::readArray(ptr, std::span(*beats));
+		ptr += count * sizeof(uint16_t);
+	}
 	
-	return pattern;
+	return DecodeResult {DecodeResult::NONE, (size_t)(ptr - chunkData.data()), pattern.rows};
 }
 
 
-std::vector<uint8_t> encodePatternStruct (TrackerPattern pattern) {
+std::vector<uint8_t> encodePatternStruct (const TrackerPattern & pattern) {
 	std::vector<uint8_t> array;
+	array.reserve(sizeof(uint32_t) + sizeof(pattern.cells) + 2 * VAR16_MAX_SIZE +
+		(pattern.beats_major.size() + pattern.beats_minor.size()) * sizeof(uint16_t));
 
 	// Row amount
-	array += BitConverter::toByteArray((uint32_t)pattern.rows);
+	BitConverter::append(array, (uint32_t)pattern.rows);
 
 	// Put the rows
-	for (auto & i : pattern.cells)
-		array += BitConverter::toByteArray(i);
+	BitConverter::appendArray(array, std::span(pattern.cells));
+
+	// Major and minor beats
+	for (auto * beats : {&pattern.beats_major, &pattern.beats_minor}) {
+		uint16_t count = beats->size();
+		size_t size = array.size();
+		array.resize(size + Var16::getSize(count));
+		Var16::writeBytes(array.data() + size, count);
+		BitConverter::appendArray(array, std::span(*beats));
+	}
 
-	// Major beats
-	auto sizeOfData = pattern.beats_major.size();
-	array += Var16::encode(sizeOfData);
+	return array;
+}
 
-	for (auto & i : pattern.beats_major)
-		array += BitConverter::toByteArray(i);
+}	// namespace RIFFLoader
 
-	// Minor beats
-	sizeOfData = pattern.beats_minor.size();
-	array += Var16::encode(sizeOfData);
-	
-	for (auto & i : pattern.beats_minor)
-		array += BitConverter::toByteArray(i);
+#pragma region projectLoadSave
 
-	return array;
+int Project::Load (const char * path) {
+	PROFILE_SCOPE("Project::Load");
+	auto file = std::make_shared<MappedFile>();
+	if (!file->open(path)) {
+		LOG_ERROR("Could not open %s\n", path);
+		return RIFF_ERROR_ACCESS;
+	}
+	return RIFFLoader::loadRIFFFile(file->data(), *this, file);
+}
+
+int Project::Load (std::ifstream & file) {
+	auto data = std::make_shared<std::vector<uint8_t>>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return RIFFLoader::loadRIFFFile(*data, *this, data);
+}
+
+int Project::Load (std::span<const uint8_t> data) {
+	return RIFFLoader::loadRIFFFile(data, *this);
 }
 
-}	// namespace RIFFLoader
\ No newline at end of file
+void Project::Save (std::ofstream & file) const {
+	RIFF::RIFFWriter writer;
+	writer.open(file);
+	RIFFLoader::saveRIFFFile(writer, *this);
+	writer.close();
+}
+
+uint8_t * Project::Save (size_t & size_out) const {
+	RIFF::RIFFWriter writer;
+
+	writer.openMem();
+
+	RIFFLoader::saveRIFFFile(writer, *this);
+
+	writer.close();
+	size_out = writer().size;
+	uint8_t * outMem = (uint8_t *)writer.file;
+	return outMem;
+}
+
+Song & Project::song (size_t index) {
+	if (!isSongLoaded(index)) {
+		PROFILE_SCOPE("Project::song");
+		std::vector<Song> decoded;
+		RIFFLoader::loadSongs({lazySongs->songs[index]}, decoded);
+		songs[index] = std::move(decoded[0]);
+		pendingSongs[index] = false;
+		if (std::find(pendingSongs.begin(), pendingSongs.end(), true) == pendingSongs.end()) {
+			lazySongs.reset();
+			pendingSongs.clear();
+		}
+	}
+	return songs[index];
+}
+
+void Project::loadAllSongs () {
+	if (!lazySongs) return;
+	PROFILE_SCOPE("Project::loadAllSongs");
+	std::vector<RIFFLoader::SongChunks> pending;
+	for (size_t i = 0; i < songs.size(); i++)
+		if (!isSongLoaded(i)) pending.push_back(lazySongs->songs[i]);
+
+	std::vector<Song> decoded;
+	RIFFLoader::loadSongs(pending, decoded);
+	for (size_t i = 0, next = 0; i < songs.size(); i++)
+		if (!isSongLoaded(i)) songs[i] = std::move(decoded[next++]);
+	lazySongs.reset();
+	pendingSongs.clear();
+}
+
+#pragma endregion
+
+#endif	// __RIFFLOADER_INCLUDED__
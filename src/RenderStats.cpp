@@ -0,0 +1,176 @@
+#ifndef __RENDER_STATS_INCLUDED__
+#define __RENDER_STATS_INCLUDED__
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+#include <mutex>
+
+#include "Profiler.cpp"
+
+// Counting wrappers around sf::RenderTarget::draw and
+// sf::Texture::update. Every raw draw into the window or a
+// render texture should go through these (TileMatrix and
+// friends already do so internally), so
+// that the performance overlay can show where the frame
+// went.
+//
+// Each thread counts on its own and closes its own frames:
+// the UI thread (caching tiles, uploading textures) with
+// RenderStats::frame(), the render thread (drawing the
+// window) with RenderStats::presented() after display().
+// They don't run in lockstep, so a UI frame and the frame
+// presented after it are kept apart, each as a whole. Both
+// keep their totals for the overlay and send them to the
+// profiler as counters.
+
+namespace RenderStats {
+
+struct Counters {
+    uint64_t drawCalls;
+    uint64_t vertices;
+    uint64_t textureUploads;
+    uint64_t uploadedBytes;
+    uint64_t targetSwitches;    // Draws into a different target than the previous draw on the same thread
+
+    Counters operator+ (const Counters & other) const {
+        return Counters {
+            drawCalls + other.drawCalls, vertices + other.vertices, textureUploads + other.textureUploads,
+            uploadedBytes + other.uploadedBytes, targetSwitches + other.targetSwitches
+        };
+    };
+};
+
+#pragma region internal
+
+namespace internal {
+
+    // Only touched by their own thread
+    inline thread_local Counters current {};
+    inline thread_local const sf::RenderTarget * lastTarget = nullptr;
+
+    inline std::mutex mutex;        // Guards the closed totals
+    inline Counters lastFrameTotals {}, lastPresentedTotals {};
+
+    inline void countDraw (const sf::RenderTarget & target, size_t vertexCount) {
+        current.drawCalls++;
+        current.vertices += vertexCount;
+        if (lastTarget != &target) current.targetSwitches++;
+        lastTarget = &target;
+    }
+
+    inline void countUpload (uint64_t bytes) {
+        current.textureUploads++;
+        current.uploadedBytes += bytes;
+    }
+
+    // Resets the calling thread's counters, returning what they were
+    inline Counters close () {
+        Counters totals = current;
+        current = Counters {};
+        lastTarget = nullptr;
+        return totals;
+    }
+
+}   // namespace internal
+
+#pragma endregion
+#pragma region drawing
+
+inline void draw (sf::RenderTarget & target, const sf::Vertex * vertices, size_t vertexCount,
+    sf::PrimitiveType type, const sf::RenderStates & states = sf::RenderStates::Default) {
+    internal::countDraw(target, vertexCount);
+    target.draw(vertices, vertexCount, type, states);
+}
+
+inline void draw (sf::RenderTarget & target, const sf::VertexArray & vertices,
+    const sf::RenderStates & states = sf::RenderStates::Default) {
+    internal::countDraw(target, vertices.getVertexCount());
+    target.draw(vertices, states);
+}
+
+#pragma endregion
+#pragma region textureUpdates
+
+/**
+ * @brief Uploads an entire texture's worth of RGBA pixels
+ */
+inline void update (sf::Texture & texture, const uint8_t * pixels) {
+    internal::countUpload((uint64_t)texture.getSize().x * texture.getSize().y * 4);
+    texture.update(pixels);
+}
+
+/**
+ * @brief Uploads a rectangle of RGBA pixels
+ */
+inline void update (sf::Texture & texture, const uint8_t * pixels, sf::Vector2u size, sf::Vector2u dest) {
+    internal::countUpload((uint64_t)size.x * size.y * 4);
+    texture.update(pixels, size, dest);
+}
+
+/**
+ * @brief Copies another texture into this one
+ * @note Stays on the GPU, but still counted as an upload
+ */
+inline void update (sf::Texture & texture, const sf::Texture & source, sf::Vector2u dest = {0, 0}) {
+    internal::countUpload((uint64_t)source.getSize().x * source.getSize().y * 4);
+    texture.update(source, dest);
+}
+
+#pragma endregion
+
+/**
+ * @brief Closes the UI thread's frame: stores its totals and resets its counters
+ * @note Call it from the UI thread
+ */
+inline void frame () {
+    using namespace internal;
+    Counters totals = close();
+    {
+        std::lock_guard lock(mutex);
+        lastFrameTotals = totals;
+    }
+
+    Profiler::counter("Draw calls",         totals.drawCalls);
+    Profiler::counter("Vertices",           totals.vertices);
+    Profiler::counter("Texture uploads",    totals.textureUploads);
+    Profiler::counter("Uploaded bytes",     totals.uploadedBytes);
+    Profiler::counter("Target switches",    totals.targetSwitches);
+}
+
+/**
+ * @brief Closes the render thread's frame once it's been presented: stores its totals and resets its counters
+ * @note Call it from the render thread, after display()
+ */
+inline void presented () {
+    using namespace internal;
+    Counters totals = close();
+    {
+        std::lock_guard lock(mutex);
+        lastPresentedTotals = totals;
+    }
+
+    Profiler::counter("Presented draw calls",       totals.drawCalls);
+    Profiler::counter("Presented vertices",         totals.vertices);
+    Profiler::counter("Presented target switches",  totals.targetSwitches);
+}
+
+/**
+ * @brief Get the totals of the UI thread's last closed frame: caching tiles and uploading textures
+ */
+inline Counters lastFrame () {
+    std::lock_guard lock(internal::mutex);
+    return internal::lastFrameTotals;
+}
+
+/**
+ * @brief Get the totals of the last presented frame: drawing it into the window
+ */
+inline Counters lastPresented () {
+    std::lock_guard lock(internal::mutex);
+    return internal::lastPresentedTotals;
+}
+
+}   // namespace RenderStats
+
+#endif  // __RENDER_STATS_INCLUDED__
@@ -1,71 +1,67 @@
 #include <SFML/System/Vector2.hpp>
+#include <algorithm>
+#include <array>
 #include <vector>
 #include "Instance.hpp"
 
 void Instance::renderInstList () {
+    PROFILE_SCOPE("Instance::renderInstList");
     auto & instruments = activeProject.globalInstruments;    // TODO: global + local, accomodate here
 
-    if (instrumentsToUpdate.size() == 0){   // Update the entire list
+    // Straight from the instruments' cached name tiles, no transcoding or text layout
+    auto renderEntry = [&](TileMatrix & output, uint16_t x, uint16_t y, uint8_t instNumber) {
+        static constexpr char HEX_DIGITS[] = "0123456789ABCDEF";
+        std::array<uint32_t, INST_ENTRY_WIDTH> tiles;
+        tiles.fill(0x20);
+        tiles[0] = TextRenderer::glyph(HEX_DIGITS[instNumber >> 4], font);
+        tiles[1] = TextRenderer::glyph(HEX_DIGITS[instNumber & 0x0F], font);
+        tiles[2] = TextRenderer::glyph(':', font);
 
+        uint8_t palette = 7;
+        if (instNumber < instruments.size()){
+            auto & name = instruments[instNumber].getNameTiles(font);
+            std::copy(name.begin(), name.end(), tiles.begin() + 3);
+            palette = instruments[instNumber].getPalette();
+            if (palette == 0) palette = 7;
+        }
 
-        TileMatrix instrumentMatrix = TileMatrix(INST_WIDTH, INST_ENTRIES_PER_COLUMN, 0x20);
-        uint8_t instNumber;
-        uint8_t palette;
+        output.copyRect(x, y, INST_ENTRY_WIDTH, 1, tiles.data());
+        output.setFlipRect(x, y, INST_ENTRY_WIDTH, 1, false, false);
+        output.fillInvertRect(x, y, INST_ENTRY_WIDTH, 1, instNumber == instSelected);
+        output.fillPaletteRect(x, y, INST_ENTRY_WIDTH, 1, palette);
+    };
 
+    if (instrumentsToUpdate.size() == 0){   // Update the entire list
+        // Lay out the whole list on the CPU first, so that the cached
+        // texture only gets redrawn once
+        TileMatrix listMatrix = TileMatrix(INST_WIDTH, INST_ENTRIES_PER_COLUMN, 0x20);
+        uint8_t instNumber;
 
         for (int i = 0; i < INST_COLUMNS; i++){
             instNumber = i * INST_ENTRIES_PER_COLUMN;
             for (int j = 0; j < INST_ENTRIES_PER_COLUMN; j++){
-                std::string output;
-                if (instNumber < instruments.size()){
-                    output = std::format("{:02X}:", instNumber) + 
-                        instruments[instNumber].getName() + " ";
-                    palette = instruments[instNumber].getPalette();
-                    if (palette == 0) palette = 7;
-                } else { 
-                    output = std::format("{:02X}:             ", instNumber);
-                    palette = 7;
-                }
-                TileMatrix string = TextRenderer::render(output, font, 15);
-                string.resize(INST_ENTRY_WIDTH, 1);
-                string.fillInvert(instNumber == instSelected);
-                string.fillPaletteRect(0, 0, INST_ENTRY_WIDTH, 1, palette);
-                instrumentMatrix.copyRect(i * INST_ENTRY_WIDTH, j, INST_ENTRY_WIDTH, 1, string, 0, 0);
+                renderEntry(listMatrix, i * INST_ENTRY_WIDTH, j, instNumber);
                 instNumber++;
             }
         }
 
-        instrumentTexture.resize(sf::Vector2u{INST_WIDTH*TILE_SIZE, INST_ENTRIES_PER_COLUMN*TILE_SIZE});
-        instrumentTexture.update(instrumentMatrix.renderToTexture(font.texture));
-
-        instrumentSprite.setTextureRect(sf::IntRect(
-            sf::Vector2i{0, 0},
-            sf::Vector2i(instrumentTexture.getSize().x, instrumentTexture.getSize().y)
-        ));
-        instrumentSprite.setTexture(instrumentTexture);
-    } else {    // Only update certain instruments
+        // The surface is only (re)allocated on the first render
+        if (instrumentMatrix.getWidth() != INST_WIDTH || instrumentMatrix.getHeight() != INST_ENTRIES_PER_COLUMN)
+            instrumentMatrix.resize(INST_WIDTH, INST_ENTRIES_PER_COLUMN);
+        if (instrumentMatrix.getTexture() != &font.texture)
+            instrumentMatrix.setTexture(font.texture);
+        instrumentMatrix.copyRect(0, 0, INST_WIDTH, INST_ENTRIES_PER_COLUMN, listMatrix, 0, 0);
+    } else {    // Only update certain instruments, in place
+        TileMatrix entry(INST_ENTRY_WIDTH, 1);
         while (instrumentsToUpdate.size() > 0){
             uint8_t instNumber = instrumentsToUpdate.back();
             instrumentsToUpdate.pop_back();
-            uint8_t palette;
-            std::string output;
-            if (instNumber < instruments.size()){
-                output = std::format("{:02X}:", instNumber) + 
-                    instruments[instNumber].getName() + " ";
-                palette = instruments[instNumber].getPalette();
-                if (palette == 0) palette = 7;
-            } else { 
-                output = std::format("{:02X}:             ", instNumber);
-                palette = 7;                 
-            }
-            TileMatrix string = TextRenderer::render(output, font, 15);
-            string.resize(INST_ENTRY_WIDTH, 1);
-            string.fillInvert(instNumber == instSelected);
-            string.fillPaletteRect(0, 0, INST_ENTRY_WIDTH, 1, palette);
-            instrumentTexture.update(string.renderToTexture(font.texture), sf::Vector2u(
-                (instNumber / INST_ENTRIES_PER_COLUMN) * INST_ENTRY_WIDTH * TILE_SIZE,
-                (instNumber % INST_ENTRIES_PER_COLUMN) * TILE_SIZE
-            ));
+            renderEntry(entry, 0, 0, instNumber);
+            instrumentMatrix.copyRect(
+                (instNumber / INST_ENTRIES_PER_COLUMN) * INST_ENTRY_WIDTH,
+                instNumber % INST_ENTRIES_PER_COLUMN,
+                INST_ENTRY_WIDTH, 1, entry, 0, 0
+            );
         }
     }
 }
@@ -0,0 +1,166 @@
+#include <mutex>
+#include <thread>
+#include "Instance.hpp"
+#include "Profiler.cpp"
+#include "RenderStats.cpp"
+
+// The render thread:
+
+/*  The UI thread (the one running ProcessEvents and Update)
+    handles input, edits the model and lays out the tiles;
+    the render thread owns the window's GL context and does
+    the clearing, drawing and the display() call, which is
+    where the framerate limiter and vsync block.
+
+    At the end of Update the UI thread fills the back slot
+    of frameStates and flips it to the front. The render
+    thread swaps the front slot out under frameMutex, so a
+    frame it is drawing is never written to, and if the UI
+    publishes several frames before it wakes up, only the
+    latest one is drawn.
+
+    When replaying a recording, the frames go into an
+    offscreen target instead and the UI thread waits for
+    each of them to be presented, see Instance::runReplay.
+
+    The tile surfaces themselves are too big to be copied
+    every frame, so they are guarded by surfaceMutex instead,
+    which neither side holds for long: the UI thread does its
+    text layout outside of it, the render thread only holds
+    it while issuing draw calls.
+
+    The mutex only orders the threads, not their GL
+    contexts: commands issued in one context aren't
+    guaranteed to be visible in another until they are
+    flushed. So the UI thread calls displaySurfaces() before
+    releasing it, which displays and flushes the cached tile
+    matrices. Texture uploads (the beats strip, the font)
+    go through sf::Texture::update(), which flushes by
+    itself for this reason.
+*/
+
+void Instance::startRenderThread () {
+    window.setActive(false);
+    {
+        std::lock_guard lock(frameMutex);
+        renderThreadRunning = true;
+    }
+    renderThread = std::thread(&Instance::renderLoop, this);
+}
+
+void Instance::stopRenderThread () {
+    {
+        std::lock_guard lock(frameMutex);
+        if (!renderThreadRunning) return;
+        renderThreadRunning = false;
+    }
+    frameCondition.notify_all();
+    if (renderThread.joinable()) renderThread.join();
+}
+
+void Instance::publishFrame () {
+    auto & back = frameStates[frontFrame ^ 1];    // Only this thread ever flips frontFrame
+    back.instrumentView = InstrumentView;
+    back.trackerView = TrackerView;
+    back.size = window.getSize();
+    back.lowerHalfMode = lowerHalfMode;
+    if (lowerHalfMode == 0) back.beats = beatsSprite;
+    else back.bezier = bezierTest;
+    back.published = Profiler::now();
+    back.number = publishedFrames + 1;     // Only this thread ever writes publishedFrames
+
+    {
+        std::lock_guard lock(frameMutex);
+        frontFrame ^= 1;
+        frameFresh = true;
+        publishedFrames++;
+    }
+    frameCondition.notify_all();
+}
+
+void Instance::displaySurfaces () {
+    instrumentMatrix.display();
+    trackerMatrix.display();
+}
+
+void Instance::waitForPresent () {
+    std::unique_lock lock(frameMutex);
+    frameCondition.wait(lock, [this]{ return presentedFrames >= publishedFrames || !renderThreadRunning; });
+}
+
+void Instance::renderLoop () {
+    if (!offscreen) window.setActive(true);
+    sf::RenderTarget & target = offscreen ? (sf::RenderTarget &)offscreenTarget : window;
+
+    FrameState frame;
+    int64_t lastPresent = -1;
+
+    while (true) {
+        {
+            std::unique_lock lock(frameMutex);
+            frameCondition.wait(lock, [this]{ return frameFresh || !renderThreadRunning; });
+            if (!renderThreadRunning) break;
+            std::swap(frame, frameStates[frontFrame]);
+            frameFresh = false;
+        }
+
+        if (offscreen && offscreenTarget.getSize() != frame.size && !offscreenTarget.resize(frame.size))
+            err("[Instance::renderLoop]: Could not resize the offscreen target to %ux%u\n", frame.size.x, frame.size.y);
+
+        {
+            PROFILE_SCOPE("RenderThread::draw");
+            std::lock_guard surfaces(surfaceMutex);
+
+            target.clear(sf::Color(255,255,0,0));
+
+            target.setView(frame.instrumentView);
+            target.draw(instrumentMatrix);
+
+            target.setView(frame.trackerView);
+
+            switch (frame.lowerHalfMode) {
+                case 0:
+                    target.draw(trackerMatrix);
+                    RenderStats::draw(target, frame.beats, sf::RenderStates(&beatsTexture));
+                    break;
+
+                case 1:
+                    target.draw(frame.bezier);
+                    break;
+            }
+
+            // 24, 36, 54
+
+            // auto selection = sf::RectangleShape(
+            //     sf::Vector2f((selectionBounds[2] - selectionBounds[0])*TILE_SIZE,
+            //     (selectionBounds[3] - selectionBounds[1])*TILE_SIZE));
+            // selection.setPosition(selectionBounds[0]*TILE_SIZE,
+            //     (selectionBounds[1]-8)*TILE_SIZE);
+            // selection.setFillColor(sf::Color(128, 128, 255, 80));
+            // window.draw(selection);
+        }
+
+        {
+            PROFILE_SCOPE("RenderThread::display");
+            if (offscreen) offscreenTarget.display();
+            else window.display();
+        }
+        RenderStats::presented();
+
+        {
+            std::lock_guard lock(frameMutex);
+            presentedFrames = frame.number;     // Skipped frames count as presented too
+        }
+        frameCondition.notify_all();
+
+        // Jitter on the presenting side, and the latency from the UI thread
+        // publishing the frame to it being presented
+        int64_t present = Profiler::now();
+        if (lastPresent >= 0)
+            Profiler::sample("RenderThread::present interval", lastPresent, present - lastPresent);
+        Profiler::sample("RenderThread::publish to present", frame.published, present - frame.published);
+        lastPresent = present;
+    }
+
+    target.setActive(false);
+}
@@ -3,13 +3,15 @@
 #include "Song.cpp"
 #include "Instrument.cpp"
 #include "Tracker.cpp"
+#include "JobSystem.cpp"
 #include <SFML/Graphics/RectangleShape.hpp>
 
 void Instance::fullRerenderTracker () {
+    PROFILE_SCOPE("Instance::fullRerenderTracker");
 
     #define TRACKER_ROW_WIDTH(effectColumns) trackerNoteWidth+1+2+(1+3)*effectColumns
 
-    Song & activeSong = activeProject.songs[currentSong];
+    Song & activeSong = activeProject.song(currentSong);
     uint8_t trackerNoteWidth = ((uint8_t)!singleTileTrackerRender)+2;
     size_t widthInTiles = std::ceil((maxResolutionVideoMode.size.x)/TILE_SIZE);
     size_t heightInTiles = std::ceil((maxResolutionVideoMode.size.y)/TILE_SIZE);
@@ -37,42 +39,53 @@ void Instance::fullRerenderTracker () {
 
     {
         std::vector<uint16_t> tracker_separator_columns(0);
-        for (int i = 0; i < rows && i < textHeight; i++){
-            auto rowNumMatrix = TextRenderer::render(std::string(std::format("{:03X}", i)), font, 3, 1, 0);
-            text.copyRect(0, i, 3, 1, rowNumMatrix, 0, 0);
-        }
+        std::array<int, 8> channelColumns;
         
         int tileCounter = 4;
         for (int i = 0; i < 8; i++) {
-
-            auto & patternData = activeSong.patternData[activeSong.patterns[0].cells[i]]; 
-
-            for (int j = 0; j < rows && j < textHeight; j++) {
-                auto row = patternData[j].render(activeSong.effectColumnAmount[i], singleTileTrackerRender);
-                text.copyRect(tileCounter, j, TRACKER_ROW_WIDTH(activeSong.effectColumnAmount[i]), 1, row, 0, 0);
-            }
-
+            channelColumns[i] = tileCounter;
             tracker_separator_columns.push_back(tileCounter-1); 
             tileCounter += TRACKER_ROW_WIDTH(activeSong.effectColumnAmount[i]) + 1;
         }
 
+        // Rows don't depend on each other, so they get laid out on the
+        // workers in batches, with this thread helping out while waiting
+        auto layout = JobSystem::createGroup();
+        JobSystem::parallelFor(layout, 0, std::min(rows, (size_t)textHeight), 16, [&](size_t j){
+            auto rowNumMatrix = TextRenderer::render(std::string(std::format("{:03X}", j)), font, 3, 1, 0);
+            text.copyRect(0, j, 3, 1, rowNumMatrix, 0, 0);
+
+            for (int i = 0; i < 8; i++) {
+                auto & patternData = *activeSong.patternData[activeSong.patterns[0].cells[i]];
+                patternData.renderRow(j, text, channelColumns[i], j, activeSong.effectColumnAmount[i], singleTileTrackerRender);
+            }
+        });
+        layout->wait();
+
+        trackerSeparatorColumns.clear();
         for (auto column : tracker_separator_columns) {
             if (widthInTiles > column){
                 header.setTile(column, 4, INTERSECTION_NOUP);
                 text.fillCol(column, COL_SEPARATOR);
+                trackerSeparatorColumns.push_back(column);
             }
         }
     }
     #pragma endregion
 
     #pragma region putTogether
+    std::lock_guard surfaces(surfaceMutex);     // Everything above is CPU-only, the render thread can keep drawing meanwhile
+
     trackerMatrix = AutoCachedTileMatrix(widthInTiles+1, textHeight+HEADER_HEIGHT, 0x20);
     
     trackerMatrix.setTexture(font.texture);
     trackerMatrix.copyRect(0, 0, widthInTiles, HEADER_HEIGHT, header, 0, 0);
     trackerMatrix.copyRect(0, HEADER_HEIGHT, std::min(widthInTiles, widthOfTracker), textHeight, text, 0, 0);
+    displaySurfaces();
     #pragma endregion
 
+    beatsCache.rows = 0;    // Layout changed, the beats overlay has to be rebuilt
+
 }
 
 
@@ -88,9 +101,10 @@ void Instance::updateTrackerPos () {
 }
 
 void Instance::updateTrackerSelection () {
+    PROFILE_SCOPE("Instance::updateTrackerSelection");
     int tileX = 3;
     uint8_t trackerNoteWidth = singleTileTrackerRender ? 2 : 3;
-    auto & effectColumnAmount = activeProject.songs[currentSong].effectColumnAmount;
+    auto & effectColumnAmount = activeProject.song(currentSong).effectColumnAmount;
 
     int x1 = selectionBounds[0], x2 = selectionBounds[2];
     int y1 = selectionBounds[1], y2 = selectionBounds[3];
@@ -194,62 +208,74 @@ void Instance::updateTrackerSelection () {
 
 }
 
-void Instance::renderBeatsTexture() {
-    auto & pattern = activeProject.songs[currentSong].patterns[0];
-    int rows = std::min(pattern.rows, (size_t)trackerMatrix.getHeight()-5);
-    if (!(trackerMatrix.getWidth() && rows)) return;
+bool Instance::renderBeatsTexture() {
+    PROFILE_SCOPE("Instance::renderBeatsTexture");
+    // Returns whether the strip has been re-rendered
+    auto & pattern = activeProject.song(currentSong).patterns[0];
+    size_t rows = std::min(pattern.rows, (size_t)std::max(trackerMatrix.getHeight()-HEADER_HEIGHT, 0));
+    if (!(trackerMatrix.getWidth() && rows)) {
+        // Nothing to overlay, drop the strip left from the last visible layout
+        beatsSprite.clear();
+        beatsCache.rows = 0;
+        return false;
+    }
     auto & maj_beats = pattern.beats_major;
     auto & min_beats = pattern.beats_minor;
-    auto colors = new uint8_t[rows]();
-    auto pixels = new uint8_t[rows*trackerMatrix.getWidth()*TILE_SIZE/2*sizeof(sf::Color)](); // automatically zeroes out alpha value
+    if (rows == beatsCache.rows && maj_beats == beatsCache.beats_major && min_beats == beatsCache.beats_minor)
+        return false;
+
+    // One RGBA pixel per row, the columns are handled by the vertices
+    std::vector<sf::Color> strip(rows, sf::Color::Transparent);
     if (min_beats.size() > 0) {
-        for (int i = 0; i < rows;) {
-            for (int j = 0; j < min_beats.size() && i < rows; j++) {
-                colors[i] = 1;
-                i += min_beats[j];
+        for (size_t i = 0; i < rows;) {
+            for (size_t j = 0; j < min_beats.size() && i < rows; j++) {
+                strip[i] = sf::Color(128, 128, 255, 48);
+                i += std::max(min_beats[j], (uint16_t)1);
             }
         }
     }
     if (maj_beats.size() > 0) {
-        for (int i = 0; i < rows;) {
-            for (int j = 0; j < maj_beats.size() && i < rows; j++) {
-                colors[i] = 2;
-                i += maj_beats[j];
-            }
-        }
-    }
-
-    size_t pixelIndex = 0;
-
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < trackerMatrix.getWidth(); j++, pixelIndex+=16) {
-            if (colors[i] > 0) {
-                for (int k = 0; k < 16; k+=4){
-                    pixels[pixelIndex+k+0] = 128;
-                    pixels[pixelIndex+k+1] = 128;
-                    pixels[pixelIndex+k+2] = 255;
-                    pixels[pixelIndex+k+3] = colors[i] == 1 ? 48 : 96;
-                }
-            }
-            if (trackerMatrix[i+HEADER_HEIGHT][j].tileIndex == COL_SEPARATOR){
-                pixels[pixelIndex+1*4+3] = 0;
-                pixels[pixelIndex+2*4+3] = 0;
+        for (size_t i = 0; i < rows;) {
+            for (size_t j = 0; j < maj_beats.size() && i < rows; j++) {
+                strip[i] = sf::Color(128, 128, 255, 96);
+                i += std::max(maj_beats[j], (uint16_t)1);
             }
         }
     }
 
-    beatsTexture.resize(sf::Vector2u(trackerMatrix.getWidth()*TILE_SIZE/2, rows));
-    beatsTexture.update(pixels);
+    if (beatsTexture.getSize() != sf::Vector2u(1, rows))
+        (void)beatsTexture.resize(sf::Vector2u(1, rows));
+    RenderStats::update(beatsTexture, reinterpret_cast<const uint8_t *>(strip.data()));
 
-    delete[] colors;
-    delete[] pixels;
+    beatsCache.beats_major = maj_beats;
+    beatsCache.beats_minor = min_beats;
+    beatsCache.rows = rows;
+    return true;
 }
 
 void Instance::updateBeatsSprite() {
-    beatsSprite = sf::RectangleShape(sf::Vector2f(beatsTexture.getSize().x, beatsTexture.getSize().y));
-    beatsSprite.setPosition({0, 5*TILE_SIZE});
-    beatsSprite.setTexture(&beatsTexture);
-    beatsSprite.setScale({(int)(TILE_SIZE / 4), TILE_SIZE});
+    // Column mask: the strip is stretched over every span between the
+    // column separators, leaving the middle half of each separator clear
+    float top = HEADER_HEIGHT*TILE_SIZE;
+    float bottom = top + beatsCache.rows*TILE_SIZE;
+    float stripHeight = beatsCache.rows;
+    auto appendSpan = [&](float left, float right) {
+        if (right <= left) return;
+        beatsSprite.append({{left, top},     sf::Color::White, {0, 0}});
+        beatsSprite.append({{right, top},    sf::Color::White, {1, 0}});
+        beatsSprite.append({{right, bottom}, sf::Color::White, {1, stripHeight}});
+        beatsSprite.append({{left, top},     sf::Color::White, {0, 0}});
+        beatsSprite.append({{right, bottom}, sf::Color::White, {1, stripHeight}});
+        beatsSprite.append({{left, bottom},  sf::Color::White, {0, stripHeight}});
+    };
+
+    beatsSprite.clear();
+    float left = 0;
+    for (auto column : trackerSeparatorColumns) {
+        appendSpan(left, column*TILE_SIZE + TILE_SIZE/4);
+        left = column*TILE_SIZE + TILE_SIZE*3/4;
+    }
+    appendSpan(left, trackerMatrix.getWidth()*TILE_SIZE);
 }
 
 void Instance::renderTimepoints() {
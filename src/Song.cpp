@@ -3,8 +3,12 @@
 
 #include <vector>
 #include <array>
+#include <memory>
+#include <unordered_set>
 
 #include "Tracker.cpp"
+#include "PatternData.cpp"
+#include "PatternPool.cpp"
 #include "Instrument.cpp"
 
 struct TrackerPattern {
@@ -12,6 +16,8 @@ struct TrackerPattern {
     std::vector<uint16_t> beats_major;
     std::vector<uint16_t> beats_minor;
     size_t rows;
+
+    bool operator== (const TrackerPattern & other) const = default;
 };
 
 class Song {
@@ -22,11 +28,92 @@ class Song {
         // The very cells
         std::vector<TrackerPattern> patterns;
 
-        std::vector<std::vector<TrackerCell>> patternData;
+        // Shared between songs and channels with the same content, see PatternPool.cpp
+        std::vector<SharedPattern> patternData;
 
         std::array<uint8_t, 8> effectColumnAmount; 
 
         std::vector<Instrument> localInstruments;
+
+        /**
+         * @brief Grows every pattern's effect capacity to fit the effect columns of the channels using it
+         */
+        void fitEffectCapacities ();
+
+        /**
+         * @brief Appends a private pattern, to be interned later with internPatterns()
+         * @return Its index
+         */
+        size_t addPattern (PatternData && data);
+
+        /**
+         * @brief Get a pattern for editing, copying it first if it's interned or shared
+         * @note The reference is valid until the next call on this song
+         */
+        PatternData & editPattern (size_t index);
+
+        /**
+         * @brief Replaces a pattern with an already shared one
+         */
+        void setPattern (size_t index, SharedPattern data);
+
+        /**
+         * @brief Interns every pattern, so identical ones share the same data
+         */
+        void internPatterns ();
+
+        /**
+         * @brief Get the heap memory used by the pattern data, counting shared patterns once
+         * @param rows Gets the total amount of rows
+         * @return In bytes
+         */
+        size_t patternMemoryUsage (size_t & rows) const;
+
+        // The data of a chunk, as last saved or loaded
+        struct StoredChunk {
+            std::vector<uint8_t> data;
+            bool compressed;    // Wrapped in a compressed chunk, see RIFFLoader.cpp
+        };
+        using EncodedChunk = std::shared_ptr<const StoredChunk>;
+
+        /**
+         * @brief Get the note chunk last encoded from a pattern, so saving can skip encoding it again
+         * @return nullptr if it hasn't been encoded, or if the pattern has changed since
+         */
+        EncodedChunk cachedNoteChunk (size_t index) const;
+        void cacheNoteChunk (size_t index, EncodedChunk data) const;
+
+        /**
+         * @brief Get the pattern chunk last encoded from patterns[index]
+         * @return nullptr if it hasn't been encoded, or if it has changed since
+         */
+        EncodedChunk cachedPatternChunk (size_t index) const;
+        void cachePatternChunk (size_t index, EncodedChunk data) const;
+
+        /**
+         * @brief Takes over the chunks cached by a copy of this song, for those that are still the same here
+         * @note For saving from a copy, e.g. autosaving
+         */
+        void adoptChunkCache (const Song & copy) const;
+
+    private:
+        // The weak_ptr tells a replaced pattern apart even if the new one is at the
+        // same address, editPattern() clears data for edits made in place
+        struct CachedNoteChunk {
+            std::weak_ptr<const PatternData> source;
+            EncodedChunk data;
+        };
+        struct CachedPatternChunk {
+            TrackerPattern source;
+            EncodedChunk data;
+        };
+        // Filled in by saving, which is const
+        mutable std::vector<CachedNoteChunk> noteChunks;
+        mutable std::vector<CachedPatternChunk> patternChunks;
+
+        // Whether patternData[i] is a copy only this song has made and can edit in place,
+        // anything past the end counts as interned
+        std::vector<bool> privatePatterns;
 };
 
 Song Song::createDefault() {
@@ -38,11 +125,98 @@ Song Song::createDefault() {
         64
     };
     output.patterns.push_back(defaultPattern);
-    output.patternData.push_back(std::vector<TrackerCell>(64));
     output.effectColumnAmount.fill(2);
+    output.patternData.push_back(PatternPool::intern(PatternData(64, 2)));
     return output;
 }
 
+void Song::fitEffectCapacities () {
+    for (auto & pattern : patterns)
+        for (size_t i = 0; i < 8; i++) {
+            if (pattern.cells[i] >= patternData.size()) continue;
+            if (patternData[pattern.cells[i]]->effectCapacity() < effectColumnAmount[i])
+                editPattern(pattern.cells[i]).setEffectCapacity(effectColumnAmount[i]);
+        }
+}
+
+size_t Song::addPattern (PatternData && data) {
+    privatePatterns.resize(patternData.size(), false);
+    patternData.push_back(std::make_shared<PatternData>(std::move(data)));
+    privatePatterns.push_back(true);
+    return patternData.size() - 1;
+}
+
+PatternData & Song::editPattern (size_t index) {
+    if (privatePatterns.size() < patternData.size())
+        privatePatterns.resize(patternData.size(), false);
+    auto & data = patternData[index];
+    if (!privatePatterns[index] || data.use_count() > 1) {
+        data = std::make_shared<PatternData>(*data);
+        privatePatterns[index] = true;
+    }
+    if (index < noteChunks.size()) noteChunks[index].data.reset();
+    return const_cast<PatternData &>(*data);     // Private copies are never made const
+}
+
+void Song::setPattern (size_t index, SharedPattern data) {
+    patternData[index] = std::move(data);
+    if (index < privatePatterns.size()) privatePatterns[index] = false;
+}
+
+void Song::internPatterns () {
+    for (auto & data : patternData)
+        data = PatternPool::intern(data);
+    privatePatterns.clear();
+}
 
+size_t Song::patternMemoryUsage (size_t & rows) const {
+    size_t bytes = 0;
+    rows = 0;
+    std::unordered_set<const PatternData *> counted;
+    for (auto & data : patternData) {
+        rows += data->size();
+        if (counted.insert(data.get()).second) bytes += data->memoryUsage();
+    }
+    return bytes;
+}
+
+
+Song::EncodedChunk Song::cachedNoteChunk (size_t index) const {
+    if (index >= noteChunks.size() || index >= patternData.size()) return nullptr;
+    auto & cached = noteChunks[index];
+    // Same control block, so the same pattern
+    if (cached.source.owner_before(patternData[index]) || patternData[index].owner_before(cached.source)) return nullptr;
+    return cached.data;
+}
+
+void Song::cacheNoteChunk (size_t index, EncodedChunk data) const {
+    if (index >= patternData.size()) return;
+    if (noteChunks.size() <= index) noteChunks.resize(index + 1);
+    noteChunks[index] = CachedNoteChunk {patternData[index], std::move(data)};
+}
+
+Song::EncodedChunk Song::cachedPatternChunk (size_t index) const {
+    if (index >= patternChunks.size() || index >= patterns.size()) return nullptr;
+    auto & cached = patternChunks[index];
+    return cached.source == patterns[index] ? cached.data : nullptr;
+}
+
+void Song::cachePatternChunk (size_t index, EncodedChunk data) const {
+    if (index >= patterns.size()) return;
+    if (patternChunks.size() <= index) patternChunks.resize(index + 1);
+    patternChunks[index] = CachedPatternChunk {patterns[index], std::move(data)};
+}
+
+void Song::adoptChunkCache (const Song & copy) const {
+    for (size_t i = 0; i < copy.noteChunks.size(); i++) {
+        auto & cached = copy.noteChunks[i];
+        if (!cached.data || i >= patternData.size() || cachedNoteChunk(i)) continue;
+        if (!cached.source.owner_before(patternData[i]) && !patternData[i].owner_before(cached.source))
+            cacheNoteChunk(i, cached.data);
+    }
+    for (size_t i = 0; i < copy.patternChunks.size(); i++)
+        if (copy.patternChunks[i].data && i < patterns.size() && copy.patternChunks[i].source == patterns[i])
+            cachePatternChunk(i, copy.patternChunks[i].data);
+}
 
 #endif  //__SONG_INCLUDED__
\ No newline at end of file
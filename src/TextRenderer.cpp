@@ -7,6 +7,7 @@
 #include "Tile.cpp"
 #include "ChrFont.cpp"
 #include "Utils.cpp"
+#include "Profiler.cpp"
 
 uint32_t excNumberTR = 0;
 #define debugNum(x) { printf("[TextRenderer #%08X]\n", x); fflush(stdout); }
@@ -23,6 +24,7 @@ struct wrappedText {
 std::u32string preprocess(std::u32string string);
 wrappedText wrapText(std::u32string text, int maxChars = -1, bool preprocess = 1);
 #if defined (__TILE_INCLUDED__) && defined(__CHRFONT_INCLUDED__) 
+    uint32_t glyph (char32_t character, const ChrFont &font);
     TileMatrix render (const wrappedText &text, const ChrFont &font, bool inverted = 0);
     TileMatrix render (std::u32string text, const ChrFont &font, int maxChars = -1, bool preprocess = 1, bool inverted = 0);
     #ifdef __STRCONVERT_INCLUDED__
@@ -123,6 +125,7 @@ std::u32string preprocess(std::u32string string){
 }
 
 wrappedText wrapText(std::u32string text, int maxChars, bool preprocess){
+    PROFILE_SCOPE("TextRenderer::wrapText");
     std::u32string inString;
     if (preprocess) inString = TextRenderer::preprocess(text);
     else inString = text;
@@ -235,10 +238,20 @@ wrappedText wrapText(std::u32string text, int maxChars, bool preprocess){
 
 #if defined (__TILE_INCLUDED__) && defined(__CHRFONT_INCLUDED__) 
 
+/**
+ * @brief Get the tile of a (preprocessed) character in the font
+ * @return 0x7F if the font doesn't have it
+ */
+uint32_t glyph (char32_t character, const ChrFont &font){
+    auto & codepages = font.codepages;
+    uint32_t bank = std::find(codepages.begin(), codepages.end(), character&0xFFFFFF80)-codepages.begin();
+    return bank < codepages.size() ? (bank<<7)|(character&0x7F) : 0x7F;
+}
+
 TileMatrix render(const wrappedText &text, const ChrFont &font, bool inverted){
+    PROFILE_SCOPE("TextRenderer::render");
 
-    auto string = text.text;
-    auto codepages = font.codepages;
+    auto & string = text.text;
 
     TileMatrix matrix(text.width, text.height, 0x20);
 
@@ -256,14 +269,7 @@ TileMatrix render(const wrappedText &text, const ChrFont &font, bool inverted){
             y++;
             x = 0;
         } else if (string[i] == 0x200B || string[i] == 0x2060){}    // ZWSP, ZWNBSP
-        else {
-            uint32_t bank = std::find(codepages.begin(), codepages.end(), string[i]&0xFFFFFF80)-codepages.begin();
-            if (bank < codepages.size()){
-                matrix.setTile(x++, y, (bank<<7)|(string[i]&0x7F));
-            } else {
-                matrix.setTile(x++, y, 0x7F);
-            }
-        }
+        else matrix.setTile(x++, y, glyph(string[i], font));
     }
     
     return matrix;
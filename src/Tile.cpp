@@ -4,6 +4,9 @@
 #include <SFML/Graphics.hpp>
 #include <vector>
 
+#include "RenderStats.cpp"
+#include "Log.cpp"
+
 #ifndef __TILE_INCLUDED__
 #define __TILE_INCLUDED__
 
@@ -298,7 +301,7 @@ class TileMatrix : public sf::Drawable {
 #define inv_arg(x) throw std::invalid_argument(x)
 #else
 uint32_t exception_count = 0;
-#define inv_arg(x) fprintf(stderr, "[Tile.cpp #%08X]: ", exception_count++); fprintf(stderr, x); fprintf(stderr, "\n")
+#define inv_arg(x) LOG_ERROR("[Tile.cpp #%08X]: %s\n", exception_count++, x)
 #endif
 
 TileMatrix::TileMatrix(uint16_t __width, uint16_t __height){
@@ -555,7 +558,7 @@ void TileMatrix::draw(sf::RenderTarget& target, sf::RenderStates states) const {
                     }
             };
 
-            target.draw(vertices, 4, sf::PrimitiveType::TriangleFan, states);
+            RenderStats::draw(target, vertices, 4, sf::PrimitiveType::TriangleFan, states);
         }
     }
 }
@@ -600,7 +603,7 @@ sf::Texture TileMatrix::renderToTexture(sf::Texture texture) const {
                         flip_palette&VFLIP?0:TILE_SIZE)
                     }
             };
-            target.draw(vertices, 4, sf::PrimitiveType::TriangleFan, sf::RenderStates(&texture));
+            RenderStats::draw(target, vertices, 4, sf::PrimitiveType::TriangleFan, sf::RenderStates(&texture));
         }
     }
     return target.getTexture();
@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <algorithm>
 #include <vector>
 #include <array>
 #include <functional>
@@ -20,14 +21,31 @@ class TrackerCell {
         uint8_t instrument;
         std::vector<EffectBase> effects;
 
-        bool attack () const {return ((flags & 1) != 0);};
-        void attack (bool in) {flags = (flags & ~1) || (in ? 1 : 0);};
+        bool attack () const {return ((flags & ATTACK_FLAG) != 0);};
+        void attack (bool in) {flags = (flags & ~ATTACK_FLAG) | (in ? ATTACK_FLAG : 0);};
 
-        bool hideInstrument () const {return ((flags & 2) != 0);};
-        void hideInstrument (bool in) {flags = (flags & ~2) || (in ? 2 : 0);};
+        bool hideInstrument () const {return ((flags & HIDE_INSTRUMENT_FLAG) != 0);};
+        void hideInstrument (bool in) {flags = (flags & ~HIDE_INSTRUMENT_FLAG) | (in ? HIDE_INSTRUMENT_FLAG : 0);};
 
         TileMatrix render(uint16_t effectColumns = 0, bool singleTile = true);
 
+        /**
+         * @brief Renders a cell given by its fields into an existing matrix
+         * @note Used by PatternData to render straight from its columns
+         * @param output 
+         * @param x Column of the note's first tile
+         * @param y 
+         * @param effectCount Amount of effects the cell has
+         * @param effectColumns Amount of effect columns to render
+         */
+        static void renderInto(TileMatrix & output, uint16_t x, uint16_t y,
+            uint8_t noteValue, uint8_t instrument, uint8_t flags, size_t effectCount,
+            uint16_t effectColumns = 0, bool singleTile = true);
+
+        static constexpr uint16_t width (uint16_t effectColumns, bool singleTile) {
+            return (singleTile ? 0 : 1)+2+1+2+std::max(effectColumns, (uint16_t)1)*(3+1);
+        };
+
         const bool operator==(const TrackerCell & other) const;
         const bool operator!=(const TrackerCell & other) const;
 
@@ -41,7 +59,13 @@ class TrackerCell {
         static constexpr uint8_t NOATTACK    = 0x1A;    // | but very left-aligned
         static constexpr uint8_t SHARP       = 0x23;    // #
         static constexpr uint8_t NOSHARP     = 0x2D;    // -
+
+        static constexpr uint8_t ATTACK_FLAG            = 1;
+        static constexpr uint8_t HIDE_INSTRUMENT_FLAG   = 2;
     private:
+        friend class PatternData;
+        friend struct std::hash<TrackerCell>;
+
         uint8_t flags = 0;  // Value not undefined
 
         static constexpr uint32_t singleNoteTileTable[] {
@@ -73,6 +97,14 @@ TrackerCell::TrackerCell(){
 }
 
 TileMatrix TrackerCell::render(uint16_t effectColumns, bool singleTile) {
+    TileMatrix output(width(effectColumns, singleTile), 1, 0x20);
+    renderInto(output, 0, 0, noteValue, instrument, flags, effects.size(), effectColumns, singleTile);
+    return output;
+}
+
+void TrackerCell::renderInto(TileMatrix & output, uint16_t x, uint16_t y,
+    uint8_t noteValue, uint8_t instrument, uint8_t flags, size_t effectCount,
+    uint16_t effectColumns, bool singleTile) {
     uint8_t tileAppend;
     uint8_t firstIndex;
     const uint32_t * noteTileTable;
@@ -86,17 +118,16 @@ TileMatrix TrackerCell::render(uint16_t effectColumns, bool singleTile) {
         noteTileTable = doubleNoteTileTable;
     }
     if (!effectColumns) effectColumns = 1;
-    TileMatrix output(tileAppend+2+1+2+effectColumns*(3+1), 1, 0x20);
     // Render note
     if (noteValue == EMPTY_NOTE){
         const uint32_t * emptyRowPtr = emptyRow+firstIndex;
-        output.copyRect(0, 0, tileAppend+2+1+2, 1, emptyRowPtr);
+        output.copyRect(x, y, tileAppend+2+1+2, 1, emptyRowPtr);
     } else if (noteValue == KEY_OFF){
         const uint32_t * keyOffRowPtr = keyOffRow+firstIndex;
-        output.copyRect(0, 0, tileAppend+2+1+2, 1, keyOffRowPtr);
+        output.copyRect(x, y, tileAppend+2+1+2, 1, keyOffRowPtr);
     } else {
         std::array<uint32_t, 5> row32;
-        if (hideInstrument()) {
+        if (flags & HIDE_INSTRUMENT_FLAG) {
             std::string row = std::format("{:1d}", noteValue/12);
             for (int i = 0; i < 2; i++) row32[i] = row[i];
             row32[2] = EMPTY; row32[3] = EMPTY;
@@ -104,37 +135,39 @@ TileMatrix TrackerCell::render(uint16_t effectColumns, bool singleTile) {
             std::string row = std::format("{:1d} {:02X}", noteValue/12, instrument);
             for (int i = 0; i < 4; i++) row32[i] = row[i];
         }
-        output.copyRect(tileAppend+1, 0, 2+1+2-1, 1, row32.data());
-        output.setTile(0, 0, noteTileTable[noteValue%12]);
-        if (!singleTile) output.setTile(1, 0, noteTileTable[12+noteValue%12]);
-        output.setTile(tileAppend+2, 0, attack() ? SPACE : NOATTACK);
+        output.copyRect(x+tileAppend+1, y, 2+1+2-1, 1, row32.data());
+        output.setTile(x, y, noteTileTable[noteValue%12]);
+        if (!singleTile) output.setTile(x+1, y, noteTileTable[12+noteValue%12]);
+        output.setTile(x+tileAppend+2, y, (flags & ATTACK_FLAG) ? SPACE : NOATTACK);
     }
     // Render effects
     {
         int i = 0;
-        for (; i < effects.size() && i < effectColumns; i++)
-            output.fillRect(tileAppend+2+1+2+1+i*(3+1), 0, 3, 1, 0x7F);
-        if (effectColumns > effects.size()){
+        for (; i < effectCount && i < effectColumns; i++)
+            output.fillRect(x+tileAppend+2+1+2+1+i*(3+1), y, 3, 1, 0x7F);
+        if (effectColumns > effectCount){
             for (; i < effectColumns; i++)
-                output.fillRect(tileAppend+2+1+2+1+i*(3+1), 0, 3, 1, EMPTY);
+                output.fillRect(x+tileAppend+2+1+2+1+i*(3+1), y, 3, 1, EMPTY);
         }
     }
-    return output;
 }
 
 template<>
 struct std::hash<TrackerCell> {
     size_t operator()(const TrackerCell & cell) const noexcept {
-        //TODO EFFECTS
-        return std::hash<std::string>{}(std::format("{:2X}/{:2X}/{:d}{:d}",  cell.noteValue, cell.instrument, cell.hideInstrument(), cell.attack()));
+        return fields(cell.noteValue, cell.instrument, cell.flags, cell.effects.size(), [&](size_t i){
+            return std::hash<EffectBase>{}(cell.effects[i]);
+        });
     }
-    /*
-    for (auto & effect : effects)
-        std::snprintf("%X", effect.exportString)
-    
-    */
-
 
+    // So that PatternData rows can be hashed without making a TrackerCell
+    template <typename EffectHash>
+    static size_t fields (uint8_t noteValue, uint8_t instrument, uint8_t flags, size_t effectCount, EffectHash && effectHash) {
+        uint64_t hash = Hash::mix(noteValue | instrument << 8 | flags << 16 | (uint64_t)effectCount << 24);
+        for (size_t i = 0; i < effectCount; i++)
+            hash = Hash::combine(hash, effectHash(i));
+        return hash;
+    }
 };
 
 const bool TrackerCell::operator==(const TrackerCell & other) const {
@@ -0,0 +1,310 @@
+#ifndef __UNDO_HISTORY_INCLUDED__
+#define __UNDO_HISTORY_INCLUDED__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Profiler.cpp"
+#include "Project.cpp"
+
+// Undo and redo:
+
+/*  Every edit to the project goes through UndoHistory,
+    which applies it and records it as a command holding
+    just what changed, so that its size does not depend on
+    the size of the project:
+        - CELLS: the before and after of every cell changed,
+          for typing and small pastes
+        - PATTERN: the pattern pointers before and after, for
+          anything touching a whole pattern at once (resizing,
+          big pastes, transposing...). Pattern data is
+          interned and copy-on-write (see PatternPool.cpp), so
+          the old version is shared with whatever else still
+          uses it and keeping it costs nothing if it's an
+          unchanged copy of another pattern.
+    Undoing applies the command backwards through
+    Song::editPattern(), so patterns shared with other songs
+    or with the undo history itself are never modified.
+
+    Cell edits to the same pattern that come within
+    COALESCE_TIME of each other (a burst of keystrokes) are
+    merged into one command, so they undo together; a cell
+    changed several times in a burst keeps its first before
+    and last after. breakCoalescing() ends a burst early,
+    e.g. when the cursor is moved by hand.
+
+    Once the recorded commands take more than the memory
+    cap, the oldest ones are dropped. The redo stack is
+    cleared by any new edit, as usual.
+
+    A PATTERN command only counts the patterns nothing but
+    the history keeps alive. That changes without the
+    command changing (undoing hands its before back to the
+    song, another song letting go of a pattern leaves it
+    to the history alone), so they are counted again with
+    every undo, redo and pattern replacement, but not with
+    every cell edit, which would make each keystroke cost
+    time proportional to the history. A pattern kept alive
+    by two commands at once isn't counted at all, so the
+    total errs on the low side.
+*/
+
+class UndoHistory {
+    public:
+        static constexpr size_t DEFAULT_MEMORY_CAP = 16 << 20;
+        static constexpr int64_t COALESCE_TIME = 1000000000;    // In nanoseconds
+
+        UndoHistory (size_t memoryCap = DEFAULT_MEMORY_CAP) : memoryCap(memoryCap) {};
+
+        /**
+         * @brief Changes a cell of a pattern and records it
+         * @param time When the edit happened, in Profiler::now() nanoseconds, for coalescing
+         */
+        void setCell (Project & project, size_t song, size_t pattern, size_t row, const TrackerCell & cell, int64_t time = Profiler::now());
+
+        /**
+         * @brief Replaces an entire pattern and records it
+         */
+        void replacePattern (Project & project, size_t song, size_t pattern, SharedPattern data);
+
+        /**
+         * @brief Undoes the last command
+         * @return Whether there was anything to undo
+         */
+        bool undo (Project & project);
+
+        /**
+         * @brief Redoes the last undone command
+         * @return Whether there was anything to redo
+         */
+        bool redo (Project & project);
+
+        bool canUndo () const { return !done.empty(); };
+        bool canRedo () const { return !undone.empty(); };
+
+        // The next edit starts a new command even if it would be coalesced
+        void breakCoalescing () { coalescing = false; };
+
+        /**
+         * @brief Forgets every command, e.g. when another project is opened
+         */
+        void clear ();
+
+        /**
+         * @brief Sets the memory cap, dropping the oldest commands if needed
+         * @param bytes The newest command is always kept, no matter its size
+         */
+        void setMemoryCap (size_t bytes);
+
+        /**
+         * @brief Get the memory taken by the recorded commands
+         * @note The patterns only the history keeps alive are as of the last undo, redo or replacePattern()
+         * @return In bytes, approximately
+         */
+        size_t memoryUsage () const { return bytes; };
+
+        // Amount of commands that can be undone / redone
+        size_t undoDepth () const { return done.size(); };
+        size_t redoDepth () const { return undone.size(); };
+
+        // Goes up with every edit, undo and redo, so others can tell whether the project has changed
+        uint64_t changes () const { return changeCount; };
+
+    private:
+        struct CellChange {
+            uint32_t row;
+            TrackerCell before;
+            TrackerCell after;
+        };
+
+        struct Command {
+            enum Type : uint8_t { CELLS, PATTERN } type = CELLS;
+            size_t song = 0;
+            size_t pattern = 0;
+            std::vector<CellChange> cells {};   // CELLS only, in the order they were made
+            SharedPattern before {}, after {};  // PATTERN only
+            int64_t lastEdit = 0;
+            size_t bytes = 0;
+        };
+
+        static size_t cellBytes (const TrackerCell & cell) { return cell.effects.capacity() * sizeof(EffectBase); };
+        static size_t commandBytes (const Command & command);
+        static Song & songOf (Project & project, const Command & command) { return project.song(command.song); };
+
+        void apply (Project & project, const Command & command, bool forwards);
+        void push (Command && command);
+        void recountPatterns ();
+        void trim (bool recount = false);
+
+        std::deque<Command> done;
+        std::vector<Command> undone;
+        size_t bytes = 0;       // Of both done and undone
+        size_t memoryCap;
+        bool coalescing = false;
+        uint64_t changeCount = 0;   // Not reset by clear(), so it never repeats
+};
+
+#pragma region implementation
+
+void UndoHistory::setCell (Project & project, size_t song, size_t pattern, size_t row, const TrackerCell & cell, int64_t time) {
+    if (song >= project.songCount() || pattern >= project.song(song).patternData.size()) return;
+    auto & data = *project.song(song).patternData[pattern];
+    if (row >= data.size()) return;
+
+    TrackerCell before = data.cell(row);
+    if (before == cell) return;
+    project.song(song).editPattern(pattern).setCell(row, cell);
+    changeCount++;
+
+    for (auto & redo : undone) bytes -= redo.bytes;
+    undone.clear();
+
+    if (coalescing && !done.empty()) {
+        auto & last = done.back();
+        if (last.type == Command::CELLS && last.song == song && last.pattern == pattern &&
+            time - last.lastEdit <= COALESCE_TIME) {
+            bytes -= last.bytes;
+            auto change = std::find_if(last.cells.begin(), last.cells.end(),
+                [&](const CellChange & change){ return change.row == row; });
+            if (change != last.cells.end()) change->after = cell;
+            else last.cells.push_back(CellChange{(uint32_t)row, std::move(before), cell});
+            last.lastEdit = time;
+            last.bytes = commandBytes(last);
+            bytes += last.bytes;
+            trim();
+            return;
+        }
+    }
+
+    Command command {Command::CELLS, song, pattern};
+    command.cells.push_back(CellChange{(uint32_t)row, std::move(before), cell});
+    command.lastEdit = time;
+    push(std::move(command));
+    coalescing = true;
+}
+
+void UndoHistory::replacePattern (Project & project, size_t song, size_t pattern, SharedPattern data) {
+    if (song >= project.songCount() || pattern >= project.song(song).patternData.size() || !data) return;
+    auto & target = project.song(song);
+    if (target.patternData[pattern] == data) return;
+
+    Command command {Command::PATTERN, song, pattern};
+    command.before = target.patternData[pattern];
+    command.after = PatternPool::intern(data);
+    command.lastEdit = Profiler::now();
+    target.setPattern(pattern, command.after);
+    changeCount++;
+
+    for (auto & redo : undone) bytes -= redo.bytes;
+    undone.clear();
+    push(std::move(command));
+    coalescing = false;
+}
+
+bool UndoHistory::undo (Project & project) {
+    if (done.empty()) return false;
+    apply(project, done.back(), false);
+    undone.push_back(std::move(done.back()));
+    done.pop_back();
+    coalescing = false;
+    changeCount++;
+    trim(true);
+    return true;
+}
+
+bool UndoHistory::redo (Project & project) {
+    if (undone.empty()) return false;
+    apply(project, undone.back(), true);
+    done.push_back(std::move(undone.back()));
+    undone.pop_back();
+    coalescing = false;
+    changeCount++;
+    trim(true);
+    return true;
+}
+
+void UndoHistory::clear () {
+    done.clear();
+    undone.clear();
+    bytes = 0;
+    coalescing = false;
+}
+
+void UndoHistory::setMemoryCap (size_t capBytes) {
+    memoryCap = capBytes;
+    trim(true);
+}
+
+#pragma endregion
+#pragma region internal
+
+size_t UndoHistory::commandBytes (const Command & command) {
+    size_t output = sizeof(Command) + command.cells.capacity() * sizeof(CellChange);
+    for (auto & change : command.cells)
+        output += cellBytes(change.before) + cellBytes(change.after);
+    // Only the patterns the undo history alone keeps alive count, the current one belongs to the song
+    for (auto * data : {&command.before, &command.after})
+        if (*data && data->use_count() == 1) output += (*data)->memoryUsage();
+    return output;
+}
+
+void UndoHistory::apply (Project & project, const Command & command, bool forwards) {
+    if (command.song >= project.songCount()) return;
+    Song & song = songOf(project, command);
+    if (command.pattern >= song.patternData.size()) return;
+
+    switch (command.type) {
+        case Command::CELLS: {
+            auto & data = song.editPattern(command.pattern);
+            if (forwards)
+                for (auto & change : command.cells) data.setCell(change.row, change.after);
+            else
+                for (auto change = command.cells.rbegin(); change != command.cells.rend(); ++change)
+                    data.setCell(change->row, change->before);
+            break;
+        }
+
+        case Command::PATTERN:
+            song.setPattern(command.pattern, forwards ? command.after : command.before);
+            break;
+    }
+}
+
+void UndoHistory::push (Command && command) {
+    command.bytes = commandBytes(command);
+    bytes += command.bytes;
+    bool recount = command.type == Command::PATTERN;   // It may have taken a pattern away from another command
+    done.push_back(std::move(command));
+    trim(recount);
+}
+
+void UndoHistory::recountPatterns () {
+    auto recount = [this](Command & command) {
+        if (command.type != Command::PATTERN) return;
+        bytes -= command.bytes;
+        command.bytes = commandBytes(command);
+        bytes += command.bytes;
+    };
+    for (auto & command : done) recount(command);
+    for (auto & command : undone) recount(command);
+}
+
+void UndoHistory::trim (bool recount) {
+    if (recount) recountPatterns();
+    // Redo history goes first, then the oldest undo history
+    while (bytes > memoryCap && !undone.empty()) {
+        bytes -= undone.front().bytes;
+        undone.erase(undone.begin());
+    }
+    while (bytes > memoryCap && done.size() > 1) {
+        bytes -= done.front().bytes;
+        done.pop_front();
+    }
+}
+
+#pragma endregion
+
+#endif  // __UNDO_HISTORY_INCLUDED__
@@ -12,6 +12,8 @@
 #include <locale>
 #include <vector>
 
+#include "Log.cpp"
+
 // utility wrapper to adapt locale-bound facets for wstring/wbuffer convert
 template<class Facet>
 struct deletable_facet : Facet
@@ -51,35 +53,13 @@ std::vector<T>& operator+=(std::vector<T>& lhs, std::array<T, N> l) {
     return lhs;
 }
 
-void printByteArray(const void * ptr, size_t size, size_t divide = 16) {
-    if (divide == 0) divide = size;
-    size_t repeats = (size_t)std::ceil((long double)size/(long double)divide);
-    size_t idx = 0;
-    for (size_t i = 0; i < repeats; i++){
-        for (size_t j = 0; j < divide; j++) {
-            if (idx+j < size)
-                printf("%02X ", *((uint8_t *)ptr+(idx+j)));
-            else
-                printf("-- ");
-        }
-        printf("| ");
-        for (size_t j = 0; j < divide && idx < size; j++){
-            if (*((char * )ptr+idx) >= 0x20 && *((char * )ptr+idx) <= 0x7F)
-                printf("%c", *((char *)ptr+(idx++)));
-            else 
-                { printf("�"); idx++; }
-        }
-        printf("\n");
-    }
-    fflush(stdout);
-}
-
+// Logged as an error, see Log.cpp
 int err(const char *format, ... ){
+	if (!Log::enabled(Log::Level::Error)) return 0;
 	va_list args;
 	va_start(args, format);
-	int r = vfprintf(stderr, format, args);
+	int r = Log::vwrite(Log::Level::Error, format, args);
 	va_end (args);
-    fflush(stderr);
 	return r;
 }
 #endif  // __STRCONVERT_INCLUDED__
\ No newline at end of file
@@ -23,16 +23,22 @@ namespace Var16 {
 #define VAR16_ROLLOVER_VALUE (0x100 - VAR16_ROLLOVER_LOWBYTE)
 
 
-uint16_t readBytes (uint8_t * & ptr) {
-	uint16_t value; 
+/**
+ * @brief Reads a Var16 number, advancing ptr past it
+ * @param end One past the last byte that can be read
+ * @return false (leaving ptr as is) if the number goes past end
+ */
+bool readBytes (const uint8_t * & ptr, const uint8_t * end, uint16_t & value) {
+	if (ptr >= end) return false;
 	if (*ptr < 0x40) {
+		if (end - ptr < 2) return false;
 		value = ((*ptr) << 8) | (*(ptr+1) & 0xFF);
 		ptr += 2;
 	} else {
 		value = (*ptr) - 0x40;
 		ptr++;
 	}
-	return value;
+	return true;
 }
 
 std::vector <uint8_t> encode (uint16_t value) {
@@ -9,19 +9,44 @@ int main (int argc, char * argv[]) {
 #else
 
 #include <cstdint>
+#include <cstring>
 #include "binIncludes.cpp"
 #include "Instance.cpp"
 
 int main(int argc, char * argv[])
 {    
-    if (argc > 1)
-        printf("CLI currently not supported, please wait for later or sumn\n");
+    InstanceOptions options;
+    const char * reportPath = nullptr;
+
+    // --record <file>: record the input into a file
+    // --replay <file> [--report <file.csv>]: replay it offscreen and print the frame times
+    // --log <trace|debug|info|warning|error>: the least severe messages to print
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--record") && i+1 < argc)
+            options.recordPath = argv[++i];
+        else if (!strcmp(argv[i], "--replay") && i+1 < argc)
+            options.replayPath = argv[++i];
+        else if (!strcmp(argv[i], "--report") && i+1 < argc)
+            reportPath = argv[++i];
+        else if (!strcmp(argv[i], "--log") && i+1 < argc) {
+            Log::Level level = Log::parseLevel(argv[++i]);
+            if (level == Log::Level::None)
+                fprintf(stderr, "Unknown log level \"%s\", expected trace, debug, info, warning or error\n", argv[i]);
+            else
+                Log::setLevel(level);
+        }
+        else
+            printf("CLI currently not supported, please wait for later or sumn\n");
+    }
 
-    Instance instance;
+    Instance instance(options);
 
     // Font stuff
     instance.addMonospaceFont(bin_font_data, bin_font_size, bin_codepages, bin_codepages_size);
 
+    if (options.replayPath)
+        return instance.runReplay(reportPath);
+
     while (instance.isWindowOpen())
     {
         instance.ProcessEvents();
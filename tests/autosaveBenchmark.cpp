@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define BITCONVERTER_ARRAY_CONVS
+#define BITCONVERTER_VECTOR_CONVS
+#include "../src/Autosave.cpp"
+#include "../src/UndoHistory.cpp"
+#include "testProjects.hpp"
+
+// Edits a large project in a simulated UI loop while it's autosaved
+// in the background, and compares the UI thread's frame times with
+// and without an autosave in flight, and the time spent copying the
+// project with saving it on the UI thread. Checks that the autosave
+// ends up at its path and that the encoded chunks make it back.
+
+constexpr size_t SONGS = 16;
+constexpr size_t PATTERNS_PER_SONG = 256;
+constexpr size_t ROWS = 256;
+constexpr size_t FRAMES = 240;
+constexpr auto FRAME_TIME = std::chrono::microseconds(16667);
+constexpr int64_t INTERVAL = 100000000;    // In nanoseconds
+
+struct FrameTimes {
+    std::vector<double> times;
+
+    void print (const char * name) {
+        if (times.empty()) return;
+        std::sort(times.begin(), times.end());
+        printf("%-20s %4zu frames, p50 %7.1f us, p99 %7.1f us, max %7.1f us\n", name, times.size(),
+            times[times.size() / 2], times[times.size() * 99 / 100], times.back());
+    }
+};
+
+int main () {
+    std::mt19937 random(1516);
+    Project project = randomProject(random, SONGS, PATTERNS_PER_SONG, ROWS);
+
+    const char * path = "autosaveBenchmark.gczr";
+    auto start = std::chrono::steady_clock::now();
+    Autosave::write(Project(project), path);
+    printf("Saving on the UI thread: %8.2f ms\n",
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e3);
+
+    JobSystem::init(std::max(std::thread::hardware_concurrency(), 2u));
+    Autosave autosave(path, INTERVAL);
+    UndoHistory history;
+    FrameTimes idle, saving;
+    int64_t slowestSnapshot = 0;
+
+    auto deadline = std::chrono::steady_clock::now();
+    for (size_t frame = 0; frame < FRAMES; frame++) {
+        auto frameStart = std::chrono::steady_clock::now();
+        JobSystem::runContinuations();
+
+        // A few keystrokes' worth of editing
+        for (int i = 0; i < 4; i++) {
+            TrackerCell cell;
+            cell.noteValue = random() % (TrackerCell::MAX_NOTE + 1);
+            cell.instrument = random() % 32;
+            cell.hideInstrument(false);
+            history.setCell(project, random() % SONGS, random() % PATTERNS_PER_SONG, random() % ROWS, cell);
+        }
+        if (autosave.update(project, history.changes()))
+            slowestSnapshot = std::max(slowestSnapshot, autosave.stats().snapshotTime);
+        bool inFlight = autosave.isSaving();
+
+        double time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - frameStart).count();
+        (inFlight ? saving : idle).times.push_back(time);
+
+        deadline += FRAME_TIME;
+        std::this_thread::sleep_until(deadline);
+    }
+    autosave.wait();
+    JobSystem::runContinuations();
+
+    idle.print("Idle frames");
+    saving.print("Autosaving frames");
+    auto & stats = autosave.stats();
+    printf("%llu autosaves, slowest snapshot %.1f us, last save %.2f ms\n",
+        (unsigned long long)stats.saves, slowestSnapshot / 1e3, stats.saveTime / 1e6);
+
+    int failures = 0;
+    if (stats.saves == 0 || stats.failed) {
+        printf("The autosaves failed\n");
+        failures++;
+    }
+    if (!std::filesystem::exists(path) || std::filesystem::exists(std::string(path) + ".tmp")) {
+        printf("The autosave wasn't renamed into place\n");
+        failures++;
+    }
+
+    // Saved once more without edits, every chunk comes from the autosave
+    autosave.saveNow(project, history.changes());
+    autosave.wait();
+    JobSystem::runContinuations();
+    for (auto & song : project.songs)
+        for (size_t i = 0; i < song.patternData.size(); i++)
+            if (!song.cachedNoteChunk(i)) failures++;
+    for (auto & song : project.songs)
+        if (!song.cachedPatternChunk(0)) failures++;
+
+    JobSystem::shutdown();
+    std::remove(path);
+    printf(failures ? "%d failures\n" : "Autosaved correctly\n", failures);
+    return failures != 0;
+}
@@ -1,39 +1,93 @@
+#include <chrono>
 #include <cstdio>
+#include <random>
+#include <vector>
 
+#define BITCONVERTER_ARRAY_CONVS
+#define BITCONVERTER_VECTOR_CONVS
 #include "../src/BitConverter.cpp"
+#include "testUtils.hpp"
 
-void printArr (const uint8_t * ptr, size_t size) {
-    printf("Contents: ");
-    for (int i = 0; i < size; i++) {
-        printf("%02X ", ptr[i]);
+// Checks the conversions at compile time and on unaligned
+// pointers (run it with -fsanitize=undefined), then measures
+// appending a list of beats one value at a time against in
+// bulk. The pattern chunks using them are measured in
+// noteStructBenchmark.cpp.
+
+constexpr int ROUNDS = 200000;
+
+static_assert(BitConverter::toBytes((uint32_t)0x12345678) == std::array<uint8_t, 4> {0x78, 0x56, 0x34, 0x12});
+static_assert(BitConverter::fromBytes<uint16_t>({0x34, 0x12}) == 0x1234);
+static_assert(BitConverter::byteswap((uint64_t)0x0123456789ABCDEF) == 0xEFCDAB8967452301);
+static_assert(BitConverter::toByteArray((uint16_t)0xBEEF) == std::array<uint8_t, 2> {0xEF, 0xBE});
+
+template <class F>
+double nanosecondsPer (F function) {
+    double best = 1e30;
+    for (int round = 0; round < 5; round++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ROUNDS; i++) function(i);
+        best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ROUNDS);
     }
-    printf("; ");
+    return best;
 }
 
-
 int main () {
+    std::mt19937 random(2024);
+
+    // Scalars, at every alignment
+    uint8_t buffer[32] = {};
+    for (size_t offset = 0; offset < 8; offset++) {
+        BitConverter::writeBytes(buffer + offset, (uint64_t)0x0123456789ABCDEF);
+        check(buffer[offset] == 0xEF && buffer[offset + 7] == 0x01, "64-bit values are written little-endian");
+        check(BitConverter::readUint64(buffer + offset) == 0x0123456789ABCDEF, "64-bit values read back");
+        BitConverter::writeBytes(buffer + offset, (uint32_t)0x12345678);
+        check(BitConverter::readUint32(buffer + offset) == 0x12345678, "32-bit values read back");
+        BitConverter::writeBytes(buffer + offset, (uint16_t)0x1234);
+        check(BitConverter::readUint16(buffer + offset) == 0x1234 && buffer[offset] == 0x34, "16-bit values read back");
+    }
+    std::vector<uint8_t> vector = BitConverter::toVector((uint32_t)0xCAFE);
+    check(vector == std::vector<uint8_t> {0xFE, 0xCA, 0, 0}, "toVector is little-endian");
+
+    // Arrays, at every alignment and length
+    uint16_t values[13], readBack[13];
+    for (auto & value : values) value = random();
+    for (size_t offset = 0; offset < 4; offset++) {
+        for (size_t count = 0; count <= 13; count++) {
+            BitConverter::writeArray(buffer + offset, std::span(values, count));
+            bool same = true;
+            for (size_t i = 0; i < count; i++) same &= BitConverter::readUint16(buffer + offset + i * 2) == values[i];
+            BitConverter::readArray(buffer + offset, std::span(readBack, count));
+            same &= std::equal(values, values + count, readBack);
+            check(same, "Arrays round-trip unaligned");
+        }
+    }
+    vector = {0xAA};
+    BitConverter::appendArray(vector, std::span(values));
+    BitConverter::append(vector, (uint16_t)0x0102);
+    check(vector.size() == 1 + sizeof(values) + 2 && vector[0] == 0xAA && BitConverter::readUint16(vector.data() + 1) == values[0] &&
+        vector[sizeof(values) + 1] == 0x02, "Appending keeps what was there");
 
-    // Test BitConverter
-    auto array = new uint8_t[8]();
-    BitConverter::writeBytes(array, (uint64_t)0x123456789ABCDEF);
-    printArr(array, 8); printf("Value: %16lX\n", uint64_t(0x123456789ABCDEF));
-    BitConverter::writeBytes(array, (uint64_t)0);
-    BitConverter::writeBytes(array, (uint32_t)0x12345678);
-    printArr(array, 8); printf("Value: %16X\n", uint32_t(0x12345678));
-    BitConverter::writeBytes(array, (uint64_t)0);
-    BitConverter::writeBytes(array, (uint16_t)0x1234);
-    printArr(array, 8); printf("Value: %16X\n", uint16_t(0x1234));
-    BitConverter::writeBytes(array, (uint64_t)0);
-
-    BitConverter::writeBytes(array, (uint64_t)0x123456789ABCDEF);
-    printArr(array, 8); printf("Value: %16lX\n", uint64_t(0x123456789ABCDEF));
-    BitConverter::writeBytes(array, (uint64_t)0);
-    BitConverter::writeBytes(array, (uint32_t)0x12345678);
-    printArr(array, 8); printf("Value: %16X\n", uint32_t(0x12345678));
-    BitConverter::writeBytes(array, (uint64_t)0);
-    BitConverter::writeBytes(array, (uint16_t)0x1234);
-    printArr(array, 8); printf("Value: %16X\n", uint16_t(0x1234));
-    BitConverter::writeBytes(array, (uint64_t)0);
-    delete[] array;
-
-}
\ No newline at end of file
+    // One value at a time against in bulk
+    std::vector<uint16_t> beats(64);
+    for (auto & beat : beats) beat = random();
+    std::vector<uint8_t> output;
+    volatile size_t sink = 0;
+    double perValue = nanosecondsPer([&](int){
+        output.clear();
+        for (auto beat : beats) {
+            auto bytes = BitConverter::toByteArray(beat);
+            output.insert(output.end(), bytes.begin(), bytes.end());
+        }
+        sink = output.size();
+    });
+    double bulk = nanosecondsPer([&](int){
+        output.clear();
+        BitConverter::appendArray(output, std::span(beats));
+        sink = output.size();
+    });
+    printf("64 beats: one by one %6.1f ns, in bulk %6.1f ns\n", perValue, bulk);
+
+    printf(failures ? "%d failures\n" : "All tests passed\n", failures);
+    return failures != 0;
+}
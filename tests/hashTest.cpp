@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../src/PatternData.cpp"
+#include "testUtils.hpp"
+
+// Checks that equal cells hash equal, counts the collisions
+// over every distinct plain cell, checks how evenly they
+// spread over a power of 2 bucket count and measures the
+// throughput.
+
+int main () {
+
+    std::hash<TrackerCell> cellHash;
+    std::hash<EffectBase> effectHash;
+
+    // Equal contents, equal hashes
+    TrackerCell a, b;
+    a.noteValue = b.noteValue = 40;
+    a.effects.push_back(EffectBase(3, {0x12, 0x34}));
+    b.effects.push_back(EffectBase(3, {0x12, 0x34}));
+    check(a == b && cellHash(a) == cellHash(b), "Equal cells hash equal");
+    b.effects[0] = EffectBase(3, {0x12, 0x35});
+    check(cellHash(a) != cellHash(b), "Different effect params hash differently");
+    check(effectHash(EffectBase(1, {})) != effectHash(EffectBase(2, {})), "Effects with no params are not all 0");
+
+    PatternData pattern(4, 1);
+    pattern.setCell(2, a);
+    check((*++++pattern.begin()).hash() == cellHash(a), "PatternData rows hash like TrackerCells");
+
+    // Every plain cell: 98 notes * 256 instruments * 4 flag combinations
+    std::vector<TrackerCell> cells;
+    for (int note = 0; note < 256; note++) {
+        if (note > TrackerCell::MAX_NOTE && note != TrackerCell::KEY_OFF && note != TrackerCell::EMPTY_NOTE) continue;
+        for (int instrument = 0; instrument < 256; instrument++)
+            for (int flags = 0; flags < 4; flags++) {
+                TrackerCell cell;
+                cell.noteValue = note;
+                cell.instrument = instrument;
+                cell.attack(flags & 1);
+                cell.hideInstrument(flags & 2);
+                cells.push_back(cell);
+            }
+    }
+
+    std::unordered_set<size_t> hashes;
+    for (auto & cell : cells) hashes.insert(cellHash(cell));
+    size_t collisions = cells.size() - hashes.size();
+    printf("%zu cells, %zu collisions\n", cells.size(), collisions);
+    check(collisions == 0, "No collisions between plain cells");
+
+    // Chi-squared over 4096 buckets, taking the low bits like a power of 2 table would
+    constexpr size_t BUCKETS = 4096;
+    std::vector<size_t> buckets(BUCKETS);
+    for (auto & cell : cells) buckets[cellHash(cell) & (BUCKETS-1)]++;
+    double expected = (double)cells.size() / BUCKETS, chiSquared = 0;
+    for (auto count : buckets) chiSquared += (count - expected) * (count - expected) / expected;
+    printf("Chi-squared over %zu buckets: %.1f (expected around %zu)\n", BUCKETS, chiSquared, BUCKETS-1);
+    check(chiSquared < BUCKETS * 1.2, "Hashes spread evenly over the buckets");
+
+    // Throughput
+    auto start = std::chrono::steady_clock::now();
+    size_t sink = 0;
+    constexpr int ROUNDS = 20;
+    for (int i = 0; i < ROUNDS; i++)
+        for (auto & cell : cells) sink += cellHash(cell);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%.1f M cell hashes/s (%zX)\n", cells.size() * ROUNDS / seconds / 1e6, sink);
+
+    std::unordered_map<TrackerCell, int> usage;
+    start = std::chrono::steady_clock::now();
+    for (auto & cell : cells) usage[cell]++;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%.1f M map insertions/s\n", cells.size() / seconds / 1e6);
+
+    printf(failures ? "%d checks failed\n" : "All checks passed\n", failures);
+    return failures != 0;
+}
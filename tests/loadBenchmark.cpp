@@ -0,0 +1,147 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#define BITCONVERTER_ARRAY_CONVS
+#define BITCONVERTER_VECTOR_CONVS
+#include "../src/RIFFLoader.cpp"
+#include "testProjects.hpp"
+
+// Builds a large synthetic project file, then measures how fast
+// Project::Load gets through it, from a memory mapped file and
+// from an ifstream, on one thread and with the job system's
+// workers, and how fast it opens with only the first song
+// decoded, then the same with compressed chunks. Checks that the
+// patterns survive the trip.
+
+constexpr size_t SONGS = 16;
+constexpr size_t PATTERNS_PER_SONG = 256;
+constexpr size_t ROWS = 256;
+constexpr int ROUNDS = 5;
+
+void appendChunk (std::vector<uint8_t> & output, const char * id, const std::vector<uint8_t> & data) {
+    output.insert(output.end(), id, id + 4);
+    output += BitConverter::toByteArray((uint32_t)data.size());
+    output.insert(output.end(), data.begin(), data.end());
+    if (data.size() & 1) output.push_back(0);
+}
+
+std::vector<uint8_t> listChunk (const char * type, const std::vector<uint8_t> & children) {
+    std::vector<uint8_t> data(type, type + 4);
+    data.insert(data.end(), children.begin(), children.end());
+    return data;
+}
+
+std::vector<uint8_t> buildFile (const std::vector<std::vector<PatternData>> & source, bool compress) {
+    std::vector<uint8_t> body(RIFFLoader::fileType, RIFFLoader::fileType + 4);
+    std::vector<uint8_t> version(RIFFLoader::thisBranch, RIFFLoader::thisBranch + 8);
+    version += BitConverter::toByteArray(RIFFLoader::thisBranchVer);
+    appendChunk(body, RIFFLoader::versionId, version);
+
+    std::vector<uint8_t> songs;
+    std::vector<std::vector<size_t>> chunkSizes;
+    for (auto & song : source) {
+        std::vector<uint8_t> children;
+        std::vector<size_t> sizes;
+        auto append = [&](const char * id, std::vector<uint8_t> && data) {
+            auto stored = compress ? RIFFLoader::storeChunk(id, std::move(data)) : nullptr;
+            if (stored && stored->compressed) {
+                id = RIFFLoader::compressedId;
+                data = stored->data;
+            } else if (stored) data = stored->data;
+            appendChunk(children, id, data);
+            sizes.push_back(data.size());
+        };
+        append(RIFFLoader::effectColumnId, std::vector<uint8_t>(8, 0));
+        for (auto & pattern : song)
+            append(RIFFLoader::noteId, RIFFLoader::encodeNoteStruct(pattern));
+        TrackerPattern order {{0, 1, 2, 3, 4, 5, 6, 7}, {16}, {4}, ROWS};
+        append(RIFFLoader::patternId, RIFFLoader::encodePatternStruct(order));
+        appendChunk(songs, RIFFLoader::listId, listChunk(RIFFLoader::songListType, children));
+        chunkSizes.push_back(std::move(sizes));
+    }
+
+    // The table of contents goes right before the songs
+    size_t tableSize = RIFFLoader::encodeTableOfContents(0, chunkSizes).size();
+    size_t songsOffset = 8 + body.size() + RIFFLoader::chunkSize(tableSize);
+    appendChunk(body, RIFFLoader::tableOfContentsId, RIFFLoader::encodeTableOfContents(songsOffset, chunkSizes));
+    body.insert(body.end(), songs.begin(), songs.end());
+
+    std::vector<uint8_t> file;
+    appendChunk(file, RIFFLoader::riffId, body);
+    return file;
+}
+
+int main () {
+    std::mt19937 random(1234);
+    std::vector<std::vector<PatternData>> source(SONGS);
+    for (auto & song : source)
+        for (size_t i = 0; i < PATTERNS_PER_SONG; i++)
+            song.push_back(randomPattern(random, ROWS));
+
+    std::vector<uint8_t> file = buildFile(source, false);
+    const char * path = "loadBenchmark.gczr";
+    std::ofstream(path, std::ios_base::binary).write((const char *)file.data(), file.size());
+    printf("Synthetic project: %zu songs, %zu patterns of %zu rows, %.1f MB\n",
+        SONGS, SONGS * PATTERNS_PER_SONG, ROWS, file.size() / 1e6);
+
+    int failures = 0;
+    auto measure = [&](const char * name, auto load) {
+        double best = 1e30;
+        for (int i = 0; i < ROUNDS; i++) {
+            Project project;
+            auto start = std::chrono::steady_clock::now();
+            load(project);
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        printf("%-12s %8.2f ms, %8.1f MB/s, %10.0f patterns/s\n", name, best * 1e3,
+            file.size() / best / 1e6, SONGS * PATTERNS_PER_SONG / best);
+    };
+
+    measure("Mapped", [&](Project & project){ project.Load(path); project.loadAllSongs(); });
+    measure("ifstream", [&](Project & project){ std::ifstream input(path, std::ios_base::binary); project.Load(input); project.loadAllSongs(); });
+    measure("Memory", [&](Project & project){ project.Load(file); });
+    measure("Lazy", [&](Project & project){ project.Load(path); });
+
+    // Random notes are about the worst case for compression
+    std::vector<uint8_t> uncompressed = std::move(file);
+    file = buildFile(source, true);
+    printf("Compressed:  %.1f MB (%.0f%%)\n", file.size() / 1e6, file.size() * 100.0 / uncompressed.size());
+    measure("Memory", [&](Project & project){ project.Load(file); });
+    Project compressed;
+    compressed.Load(file);
+    for (size_t song = 0; song < SONGS; song++)
+        for (size_t i = 0; i < PATTERNS_PER_SONG; i++)
+            if (*compressed.songs[song].patternData[i] != source[song][i]) {
+                printf("Song %zu pattern %zu differs after compression\n", song, i);
+                failures++;
+            }
+    file = std::move(uncompressed);
+
+    JobSystem::init(std::max(std::thread::hardware_concurrency(), 2u));
+    printf("With %zu workers:\n", JobSystem::internal::workers.size());
+    measure("Mapped", [&](Project & project){ project.Load(path); project.loadAllSongs(); });
+    measure("Memory", [&](Project & project){ project.Load(file); });
+
+    Project project;
+    if (project.Load(path) != 0 || project.songCount() != SONGS) failures++;
+    else {
+        if (!project.isSongLoaded(0) || project.isSongLoaded(1)) {
+            printf("Only the first song should be loaded right away\n");
+            failures++;
+        }
+        // Backwards, so that the songs get loaded one by one
+        for (size_t song = SONGS; song-- > 0;) {
+            if (project.song(song).patternData.size() != PATTERNS_PER_SONG) { failures++; continue; }
+            for (size_t i = 0; i < PATTERNS_PER_SONG; i++)
+                if (*project.song(song).patternData[i] != source[song][i]) failures++;
+        }
+    }
+
+    JobSystem::shutdown();
+    std::remove(path);
+    printf(failures ? "%d mismatches\n" : "All patterns loaded correctly\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../src/Log.cpp"
+#include "testUtils.hpp"
+
+// Checks the levels, that disabled messages don't evaluate their
+// arguments and that the sink thread writes out every message,
+// then measures what a message costs the thread logging it:
+// disabled, compiled out, written right away and queued.
+
+constexpr int MESSAGES = 100000;
+
+size_t countLines (const std::string & text, const char * prefix) {
+    size_t count = 0;
+    for (size_t i = 0; (i = text.find(prefix, i)) != std::string::npos; i++) count++;
+    return count;
+}
+
+template <class F>
+double nanosecondsPer (F function) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < MESSAGES; i++) function(i);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / MESSAGES;
+}
+
+int main () {
+    FILE * output = tmpfile(), * errors = tmpfile();
+    Log::setOutput(output, errors);
+
+    // Levels and streams
+    Log::setLevel(Log::Level::Info);
+    LOG_DEBUG("hidden\n");
+    LOG_INFO("info %d\n", 1);
+    LOG_WARNING("warning %s\n", "2");
+    LOG_BYTES(Log::Level::Info, "GCZR", 4);
+    check(readAll(output) == "info 1\n47 43 5A 52 -- -- -- -- -- -- -- -- -- -- -- -- | GCZR\n", "Info and below go to the output");
+    check(readAll(errors) == "warning 2\n", "Warnings go to the error output");
+
+    // Arguments are only evaluated once the level passes
+    int evaluated = 0;
+    LOG_DEBUG("%d\n", evaluated++);
+    check(evaluated == 0, "Disabled messages don't evaluate their arguments");
+    Log::setLevel(Log::Level::Trace);
+    LOG_TRACE("%d\n", evaluated++);
+    check(evaluated == (LOG_COMPILE_LEVEL == 0), "Trace is compiled out by default");
+    check(Log::parseLevel("warning") == Log::Level::Warning && Log::parseLevel("loud") == Log::Level::None, "Level names parse");
+
+    // Every message makes it through the sink thread, or is counted as dropped
+    Log::setLevel(Log::Level::Info);
+    output = freopen(nullptr, "w+", output);
+    errors = freopen(nullptr, "w+", errors);
+    Log::setOutput(output, errors);
+    Log::start();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; t++)
+        threads.emplace_back([t]{ for (int i = 0; i < MESSAGES / 2; i++) LOG_INFO("message %d %d\n", t, i); });
+    for (auto & thread : threads) thread.join();
+    Log::stop();
+    std::string errorText = readAll(errors);
+    size_t dropped = 0;
+    for (size_t i = 0; (i = errorText.find("[Log]: ", i)) != std::string::npos; i++)
+        dropped += strtoull(errorText.c_str() + i + 7, nullptr, 10);
+    size_t written = countLines(readAll(output), "message ");
+    printf("%zu messages written, %zu dropped\n", written, dropped);
+    check(written + dropped == MESSAGES, "Every message is written or counted as dropped");
+
+    // Cost to the caller
+    output = freopen(nullptr, "w+", output);
+    Log::setOutput(output, errors);
+    Log::setLevel(Log::Level::Info);
+    printf("Disabled:     %7.1f ns\n", nanosecondsPer([](int i){ LOG_DEBUG("message %d\n", i); }));
+    printf("Compiled out: %7.1f ns\n", nanosecondsPer([](int i){ LOG_TRACE("message %d\n", i); }));
+    printf("Synchronous:  %7.1f ns\n", nanosecondsPer([](int i){ LOG_INFO("message %d\n", i); }));
+    Log::start();
+    printf("Queued:       %7.1f ns\n", nanosecondsPer([](int i){ LOG_INFO("message %d\n", i); }));
+    Log::stop();
+
+    Log::setOutput(stdout, stderr);
+    fclose(output);
+    fclose(errors);
+    printf(failures ? "%d failures\n" : "All tests passed\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,128 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#define BITCONVERTER_ARRAY_CONVS
+#define BITCONVERTER_VECTOR_CONVS
+#include "../src/RIFFLoader.cpp"
+#include "testProjects.hpp"
+#include "testUtils.hpp"
+
+// Round-trips the LZ codec over edge cases and pattern data,
+// checks that corrupt data is rejected without reading or
+// writing out of bounds (run it with -fsanitize=address), and
+// measures the ratio and throughput on note chunks of patterns
+// that repeat like music does and of random notes.
+
+bool roundTrips (const std::vector<uint8_t> & data) {
+    auto compressed = LZ::compress(data);
+    std::vector<uint8_t> output(data.size());
+    return LZ::decompress(compressed, output) && output == data;
+}
+
+// A bar of a few notes, repeated with some variation, like a bass line or a drum part
+PatternData musicalPattern (std::mt19937 & random, size_t rows) {
+    PatternData pattern(rows, 0);
+    std::vector<TrackerCell> bar(16);
+    for (auto & cell : bar) {
+        if (random() % 3) continue;
+        cell.noteValue = 36 + random() % 24;
+        cell.instrument = random() % 4;
+        cell.hideInstrument(false);
+    }
+    for (size_t row = 0; row < rows; row++) {
+        TrackerCell cell = bar[row % bar.size()];
+        if (cell.noteValue <= TrackerCell::MAX_NOTE && random() % 8 == 0) cell.noteValue += 12;
+        pattern.setCell(row, cell);
+    }
+    return pattern;
+}
+
+void benchmark (const char * name, const std::vector<std::vector<uint8_t>> & chunks) {
+    size_t rawSize = 0, storedSize = 0, compressedCount = 0;
+    std::vector<Song::EncodedChunk> stored;
+    auto start = std::chrono::steady_clock::now();
+    for (auto & chunk : chunks) {
+        stored.push_back(RIFFLoader::storeChunk(RIFFLoader::noteId, std::vector<uint8_t>(chunk)));
+        rawSize += chunk.size();
+        storedSize += stored.back()->data.size();
+        compressedCount += stored.back()->compressed;
+    }
+    double compressTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Only the compressed ones, the rest would be just a span
+    double decompressTime = 1e30;
+    size_t decompressedSize = 0;
+    std::vector<uint8_t> buffer;
+    for (int round = 0; round < 5; round++) {
+        decompressedSize = 0;
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < chunks.size(); i++) {
+            if (!stored[i]->compressed) continue;
+            std::span<const uint8_t> data;
+            check(RIFFLoader::readChunk({stored[i]->data, true}, buffer, data) && data.size() == chunks[i].size(), "Stored chunks decompress");
+            decompressedSize += data.size();
+        }
+        decompressTime = std::min(decompressTime, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    printf("%-8s %5zu chunks, %4zu compressed, %7.1f kB -> %7.1f kB (%3.0f%%), compress %6.0f MB/s, decompress %6.0f MB/s\n",
+        name, chunks.size(), compressedCount, rawSize / 1e3, storedSize / 1e3, storedSize * 100.0 / rawSize,
+        rawSize / compressTime / 1e6, decompressedSize ? decompressedSize / decompressTime / 1e6 : 0);
+}
+
+int main () {
+    std::mt19937 random(1718);
+
+    // Edge cases: nothing, too short to match, long runs, long matches and far offsets
+    check(roundTrips({}), "Empty data");
+    check(roundTrips({1, 2, 3}), "Shorter than a match");
+    check(roundTrips(std::vector<uint8_t>(100000, 7)), "A long run of 1 byte");
+    std::vector<uint8_t> data;
+    for (int i = 0; i < 5000; i++) data.push_back(i % 7);
+    check(roundTrips(data), "A short period");
+    data.clear();
+    for (int i = 0; i < 300000; i++) data.push_back(random());
+    check(roundTrips(data), "Random data");
+    check(LZ::compress(data).size() < data.size() * 101 / 100, "Random data barely grows");
+    std::vector<uint8_t> far(data.begin(), data.begin() + 70000);
+    far.insert(far.end(), data.begin(), data.begin() + 70000);
+    check(roundTrips(far), "A repeat past the maximum offset");
+
+    // Corrupt data: every truncation and a lot of flipped bytes
+    for (int i = 0; i < 20000; i++) data[i] = i % 251 < 200 ? i % 13 : random();
+    data.resize(20000);
+    auto compressed = LZ::compress(data);
+    std::vector<uint8_t> output(data.size());
+    bool truncationsFail = true;
+    for (size_t size = 0; size < compressed.size(); size++)
+        // Only dropping the empty last sequence can still succeed
+        if (LZ::decompress(std::span(compressed).first(size), output) && output != data) truncationsFail = false;
+    check(truncationsFail, "Every truncation fails");
+    for (int i = 0; i < 20000; i++) {
+        auto corrupt = compressed;
+        corrupt[random() % corrupt.size()] = random();
+        LZ::decompress(corrupt, output);    // Can't tell in general, but mustn't go out of bounds
+    }
+    std::vector<uint8_t> bomb {RIFFLoader::noteId, RIFFLoader::noteId + 4};
+    bomb += BitConverter::toByteArray((uint32_t)0xFFFFFFFF);
+    bomb.push_back(0);
+    std::vector<uint8_t> buffer;
+    std::span<const uint8_t> decoded;
+    check(!RIFFLoader::readChunk({bomb, true}, buffer, decoded), "A huge stated size is rejected before allocating");
+
+    // Pattern data, as the note chunks of 256 row patterns
+    std::vector<std::vector<uint8_t>> musical, noise;
+    for (int i = 0; i < 4096; i++) {
+        auto pattern = musicalPattern(random, 256);
+        musical.push_back(RIFFLoader::encodeNoteStruct(pattern));
+        check(roundTrips(musical.back()), "Musical note chunk");
+        noise.push_back(RIFFLoader::encodeNoteStruct(randomPattern(random, 256)));
+    }
+    benchmark("Musical", musical);
+    benchmark("Random", noise);
+
+    printf(failures ? "%d failures\n" : "All tests passed\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,100 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#define BITCONVERTER_ARRAY_CONVS
+#define BITCONVERTER_VECTOR_CONVS
+#include "../src/RIFFLoader.cpp"
+#include "testProjects.hpp"
+
+// Measures how fast note chunks decode, for patterns of a few
+// densities, and how fast pattern chunks encode and decode, and
+// checks that they decode back to what was encoded (the pattern
+// chunks from an odd address too, so run it with
+// -fsanitize=undefined to catch misaligned reads).
+
+constexpr size_t PATTERNS = 512;
+constexpr size_t ROWS = 256;
+constexpr int ROUNDS = 5;
+constexpr size_t PATTERN_STRUCTS = 256;
+constexpr int PATTERN_STRUCT_ROUNDS = 200;
+
+TrackerPattern randomPatternStruct (std::mt19937 & random) {
+    TrackerPattern pattern;
+    pattern.rows = 64 + random() % 192;
+    for (auto & cell : pattern.cells) cell = random();
+    for (auto * beats : {&pattern.beats_major, &pattern.beats_minor}) {
+        beats->resize(random() % 64);
+        for (auto & beat : *beats) beat = random();
+    }
+    return pattern;
+}
+
+int main () {
+    std::mt19937 random(5678);
+    int failures = 0;
+
+    for (unsigned density : {5, 25, 100}) {
+        std::vector<PatternData> patterns;
+        std::vector<std::vector<uint8_t>> chunks;
+        size_t bytes = 0;
+        for (size_t i = 0; i < PATTERNS; i++) {
+            PatternData pattern = randomPattern(random, ROWS, density);
+            chunks.push_back(RIFFLoader::encodeNoteStruct(pattern));
+            bytes += chunks.back().size();
+            patterns.push_back(std::move(pattern));
+        }
+
+        double best = 1e30;
+        PatternData output;
+        for (int round = 0; round < ROUNDS; round++) {
+            auto start = std::chrono::steady_clock::now();
+            for (auto & chunk : chunks)
+                if (RIFFLoader::decodeNoteStruct(chunk, output)) failures++;
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        printf("%3u%% full: %8.1f MB/s, %6.1f M rows/s\n", density,
+            bytes / best / 1e6, PATTERNS * ROWS / best / 1e6);
+
+        for (size_t i = 0; i < PATTERNS; i++) {
+            if (RIFFLoader::decodeNoteStruct(chunks[i], output) || output != patterns[i]) failures++;
+        }
+    }
+
+    // Pattern chunks: the rows, the channels' patterns and the beat lists
+    std::vector<TrackerPattern> structs;
+    std::vector<std::vector<uint8_t>> structChunks;
+    size_t structBytes = 0;
+    for (size_t i = 0; i < PATTERN_STRUCTS; i++) {
+        structs.push_back(randomPatternStruct(random));
+        structChunks.push_back(RIFFLoader::encodePatternStruct(structs.back()));
+        structBytes += structChunks.back().size();
+
+        std::vector<uint8_t> shifted {0};
+        shifted += structChunks.back();
+        TrackerPattern decoded;
+        if (RIFFLoader::decodePatternStruct(std::span(shifted).subspan(1), decoded) || decoded != structs.back()) failures++;
+    }
+
+    double bestEncode = 1e30, bestDecode = 1e30;
+    volatile size_t sink = 0;
+    TrackerPattern decoded;
+    for (int round = 0; round < ROUNDS; round++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < PATTERN_STRUCT_ROUNDS; i++)
+            for (auto & pattern : structs) sink = RIFFLoader::encodePatternStruct(pattern).size();
+        bestEncode = std::min(bestEncode, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < PATTERN_STRUCT_ROUNDS; i++)
+            for (auto & chunk : structChunks) sink = (bool)RIFFLoader::decodePatternStruct(chunk, decoded);
+        bestDecode = std::min(bestDecode, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    double count = PATTERN_STRUCTS * PATTERN_STRUCT_ROUNDS;
+    printf("Pattern chunks, %zu bytes on average: encode %6.1f ns, decode %6.1f ns\n",
+        structBytes / PATTERN_STRUCTS, bestEncode / count * 1e9, bestDecode / count * 1e9);
+
+    printf(failures ? "%d patterns did not decode correctly\n" : "All patterns decoded correctly\n", failures);
+    return failures != 0;
+}
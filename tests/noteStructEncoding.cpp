@@ -0,0 +1,156 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#define BITCONVERTER_ARRAY_CONVS
+#define BITCONVERTER_VECTOR_CONVS
+#include "../src/RIFFLoader.cpp"
+
+// Checks that encodeNoteStruct round-trips, and compares its
+// output with writing every row out (the format without repeats
+// and with only the empty cell as the default), on a few kinds
+// of patterns.
+
+constexpr size_t PATTERNS = 256;
+constexpr int ROUNDS = 5;
+
+// Every row written out, except empty ones
+size_t plainSize (const PatternData & pattern) {
+    size_t size = sizeof(uint32_t) + pattern.size();
+    pattern.forEachEvent([&](const PatternData::Row & row){
+        TrackerCell cell = row.toCell();
+        size += 1 + !cell.hideInstrument();
+    });
+    return size;
+}
+
+TrackerCell note (std::mt19937 & random, uint8_t noteValue, uint8_t instrument) {
+    TrackerCell cell;
+    cell.noteValue = noteValue;
+    cell.instrument = instrument;
+    cell.hideInstrument(false);
+    cell.attack(random() % 8 != 0);
+    return cell;
+}
+
+// A melody: a note every few rows, mostly one instrument, some key offs
+PatternData melody (std::mt19937 & random) {
+    PatternData pattern(64, 0);
+    uint8_t instrument = random() % 4;
+    for (size_t row = 0; row < 64; row += 1 + random() % 4) {
+        if (random() % 6 == 0) {
+            TrackerCell off;
+            off.noteValue = TrackerCell::KEY_OFF;
+            pattern.setCell(row, off);
+        } else pattern.setCell(row, note(random, 36 + random() % 24, random() % 8 ? instrument : random() % 4));
+    }
+    return pattern;
+}
+
+// Drums: the same few cells on a grid
+PatternData drums (std::mt19937 & random) {
+    PatternData pattern(64, 0);
+    TrackerCell kick = note(random, 24, 1), snare = note(random, 38, 2), hat = note(random, 54, 3);
+    for (size_t row = 0; row < 64; row++) {
+        if (row % 8 == 0) pattern.setCell(row, kick);
+        else if (row % 8 == 4) pattern.setCell(row, snare);
+        else if (row % 2 == 0 || random() % 5 == 0) pattern.setCell(row, hat);
+    }
+    return pattern;
+}
+
+// An arpeggio on every row, the instrument only on the first
+PatternData arpeggio (std::mt19937 & random) {
+    PatternData pattern(256, 0);
+    uint8_t root = 36 + random() % 24;
+    uint8_t chord[] = {0, 4, 7, 12};
+    for (size_t row = 0; row < 256; row++) {
+        TrackerCell cell = note(random, root + chord[(row / 2) % 4], 5);
+        cell.hideInstrument(row != 0);
+        if (row != 0) cell.instrument = 0;
+        cell.attack(true);
+        pattern.setCell(row, cell);
+        if (row % 64 == 63) root = 36 + random() % 24;
+    }
+    return pattern;
+}
+
+// Anything at all
+PatternData noise (std::mt19937 & random) {
+    PatternData pattern(1 + random() % 300, 0);
+    for (size_t row = 0; row < pattern.size(); row++) {
+        if (random() % 3 == 0) continue;
+        TrackerCell cell;
+        switch (random() % 4) {
+            case 0: cell.noteValue = TrackerCell::KEY_OFF; break;
+            case 1: cell.noteValue = TrackerCell::EMPTY_NOTE; break;
+            default: cell.noteValue = random() % (TrackerCell::MAX_NOTE + 1); break;
+        }
+        if (random() % 2) {
+            cell.hideInstrument(false);
+            cell.instrument = random() % 3;
+        }
+        cell.attack(random() % 2);
+        pattern.setCell(row, cell);
+    }
+    return pattern;
+}
+
+int main () {
+    std::mt19937 random(91011);
+    int failures = 0;
+
+    struct Kind { const char * name; PatternData (* generate)(std::mt19937 &); };
+    for (auto kind : {Kind{"Melody", melody}, Kind{"Drums", drums}, Kind{"Arpeggio", arpeggio}, Kind{"Noise", noise}}) {
+        std::vector<PatternData> patterns;
+        std::vector<std::vector<uint8_t>> chunks;
+        size_t plain = 0, encoded = 0, rows = 0;
+        for (size_t i = 0; i < PATTERNS; i++) patterns.push_back(kind.generate(random));
+
+        double encodeTime = 1e30, decodeTime = 1e30;
+        for (int round = 0; round < ROUNDS; round++) {
+            chunks.clear();
+            auto start = std::chrono::steady_clock::now();
+            for (auto & pattern : patterns) chunks.push_back(RIFFLoader::encodeNoteStruct(pattern));
+            encodeTime = std::min(encodeTime, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+            PatternData output;
+            start = std::chrono::steady_clock::now();
+            for (auto & chunk : chunks) RIFFLoader::decodeNoteStruct(chunk, output);
+            decodeTime = std::min(decodeTime, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        for (size_t i = 0; i < PATTERNS; i++) {
+            PatternData output;
+            auto result = RIFFLoader::decodeNoteStruct(chunks[i], output);
+            if (result || result.offset != chunks[i].size() || output != patterns[i]) {
+                if (!failures) printf("%s pattern %zu does not round-trip (%s at byte %zu)\n", kind.name, i, result.toString(), result.offset);
+                failures++;
+            }
+            plain += plainSize(patterns[i]);
+            encoded += chunks[i].size();
+            rows += patterns[i].size();
+        }
+
+        printf("%-9s %7zu -> %7zu bytes (%5.1f%%), %6.2f bytes/row, encode %6.1f M rows/s, decode %6.1f M rows/s\n",
+            kind.name, plain, encoded, 100.0 * encoded / plain, (double)encoded / rows,
+            rows / encodeTime / 1e6, rows / decodeTime / 1e6);
+    }
+
+    // Long patterns go through several blocks
+    for (size_t rows : {4095, 4096, 4097, 20000}) {
+        PatternData pattern(rows, 0);
+        for (size_t row = 0; row < rows; row++)
+            if (row % 3 == 0) pattern.setCell(row, note(random, 40, 1));
+        PatternData output;
+        auto chunk = RIFFLoader::encodeNoteStruct(pattern);
+        if (RIFFLoader::decodeNoteStruct(chunk, output) || output != pattern) {
+            printf("%zu row pattern does not round-trip\n", rows);
+            failures++;
+        }
+    }
+
+    printf(failures ? "%d patterns did not round-trip\n" : "All patterns round-tripped\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#define BITCONVERTER_ARRAY_CONVS
+#define BITCONVERTER_VECTOR_CONVS
+#include "../src/RIFFLoader.cpp"
+#include "testProjects.hpp"
+
+// Fuzz target for the chunk and pattern decoders.
+// With libFuzzer:
+//     clang++ -std=c++20 -g -O1 -fsanitize=fuzzer,address,undefined -DLIBFUZZER tests/noteStructFuzz.cpp
+// Without it, main() below mutates valid note chunks at random:
+//     ./noteStructFuzz [iterations]
+// Either way, build with sanitizers so that an out of bounds read shows up.
+
+extern "C" int LLVMFuzzerTestOneInput (const uint8_t * data, size_t size) {
+    std::span<const uint8_t> input(data, size);
+
+    PatternData pattern;
+    auto result = RIFFLoader::decodeNoteStruct(input, pattern);
+    if (result.offset > size || pattern.size() > RIFFLoader::MAX_PATTERN_ROWS) abort();
+    if (!result && result.rows != pattern.size()) abort();
+
+    TrackerPattern order;
+    result = RIFFLoader::decodePatternStruct(input, order);
+    if (result.offset > size) abort();
+
+    RIFFLoader::ChunkReader reader(input);
+    RIFFLoader::Chunk chunk;
+    while (!reader.next(chunk))
+        if (chunk.data.data() < data || chunk.data.data() + chunk.data.size() > data + size) abort();
+
+    return 0;
+}
+
+#ifndef LIBFUZZER
+
+int main (int argc, char * argv[]) {
+    size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+    std::mt19937 random(42);
+
+    // Valid chunks to start mutating from
+    std::vector<std::vector<uint8_t>> seeds;
+    for (unsigned density : {0, 10, 50, 100}) {
+        seeds.push_back(RIFFLoader::encodeNoteStruct(randomPattern(random, 64, density)));
+    }
+
+    for (size_t i = 0; i < iterations; i++) {
+        auto input = seeds[random() % seeds.size()];
+        switch (random() % 4) {
+            case 0: input.resize(random() % (input.size() + 1)); break;        // Truncate
+            case 1: input.push_back(random()); break;                           // Grow
+            default: break;
+        }
+        for (unsigned flips = random() % 8; flips > 0 && !input.empty(); flips--)
+            input[random() % input.size()] = random();
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+
+    printf("%zu inputs decoded without errors\n", iterations);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,136 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../src/PatternData.cpp"
+#include "testUtils.hpp"
+
+// Runs random edits (setting empty and non-empty cells,
+// growing and shrinking) on a PatternData and on a plain
+// std::vector<TrackerCell>, checking after every one that
+// cell(), the iterator, forEachEvent() and events() agree
+// with the vector, through both storages and the switches
+// between them. Then checks which effects fit in a slot and
+// round-trips patterns through optimize() from either
+// storage.
+
+constexpr uint8_t CAPACITY = 2;
+constexpr int OPERATIONS = 20000;
+
+TrackerCell randomCell (std::mt19937 & random) {
+    TrackerCell cell;
+    cell.noteValue = random() % (TrackerCell::MAX_NOTE + 1);
+    cell.instrument = random() % 32;
+    cell.hideInstrument(random() % 2);
+    size_t effects = random() % (CAPACITY + 1);
+    for (size_t i = 0; i < effects; i++) cell.effects.push_back(EffectBase(1 + random() % 16, {(uint8_t)random()}));
+    return cell;
+}
+
+// Whether the pattern holds exactly the reference, read every way there is
+bool matches (const PatternData & pattern, const std::vector<TrackerCell> & reference) {
+    if (pattern.size() != reference.size()) return false;
+    size_t events = 0;
+    for (size_t row = 0; row < reference.size(); row++) {
+        if (!(pattern.cell(row) == reference[row])) return false;
+        events += !(reference[row] == PatternData::EMPTY_CELL);
+    }
+    if (pattern.events() != events) return false;
+
+    size_t row = 0;
+    for (auto cell : pattern) {
+        if (cell.row != row || !(cell.toCell() == reference[row]) || cell.empty() != (reference[row] == PatternData::EMPTY_CELL))
+            return false;
+        row++;
+    }
+    if (row != reference.size()) return false;
+
+    size_t visited = 0, previous = SIZE_MAX;
+    bool inOrder = true;
+    pattern.forEachEvent([&](const PatternData::Row & cell){
+        inOrder &= !cell.empty() && (previous == SIZE_MAX || cell.row > previous) && cell.toCell() == reference[cell.row];
+        previous = cell.row;
+        visited++;
+    });
+    return inOrder && visited == events;
+}
+
+int main () {
+    std::mt19937 random(36);
+
+    // Random edits, densities drifting between nearly empty and nearly full
+    PatternData pattern(64, CAPACITY);
+    std::vector<TrackerCell> reference(64, PatternData::EMPTY_CELL);
+    bool toDense = false, toSparse = false;
+    int fill = 10;      // Percent of the set cells that aren't empty
+    for (int i = 0; i < OPERATIONS; i++) {
+        if (i % 1000 == 0) fill = random() % 101;
+        auto storage = pattern.storage();
+        if (random() % 50 == 0) {
+            size_t rows = random() % 2 ? reference.size() + random() % 64 : random() % (reference.size() + 1);
+            pattern.resize(rows);
+            reference.resize(rows, PatternData::EMPTY_CELL);
+        } else if (!reference.empty()) {
+            size_t row = random() % reference.size();
+            TrackerCell cell = (int)(random() % 100) < fill ? randomCell(random) : PatternData::EMPTY_CELL;
+            pattern.setCell(row, cell);
+            reference[row] = cell;
+        }
+        toDense |= storage == PatternData::Storage::Sparse && pattern.storage() == PatternData::Storage::Dense;
+        toSparse |= storage == PatternData::Storage::Dense && pattern.storage() == PatternData::Storage::Sparse;
+        if (!matches(pattern, reference)) {
+            printf("FAIL: Random edits, at operation %d\n", i);
+            failures++;
+            break;
+        }
+    }
+    check(toDense && toSparse, "The edits switched the storage both ways");
+
+    // Setting a row past the end does nothing
+    size_t events = pattern.events();
+    pattern.setCell(pattern.size(), randomCell(random));
+    check(pattern.events() == events && matches(pattern, reference), "Rows past the end are ignored");
+
+    // Every effect id fits in a slot, parameters only up to EffectSlot::MAX_PARAMS
+    PatternData effects(4, CAPACITY);
+    TrackerCell cell;
+    cell.effects = {EffectBase(0xFF, {1, 2}), EffectBase(0, {})};
+    effects.setCell(1, cell);
+    check(effects.cell(1) == cell && effects.events() == 1, "Effects with ids 0xFF and 0 are kept");
+    cell.effects = {EffectBase(7, {1, 2, 3, 4, 5})};
+    effects.setCell(2, cell);
+    check(effects.cell(2).effects[0] == EffectBase(7, {1, 2, 3}), "Parameters past MAX_PARAMS are dropped");
+
+    // Shrinking away every non-empty row and growing back leaves empty rows
+    pattern.resize(0);
+    reference.clear();
+    pattern.resize(128);
+    reference.resize(128, PatternData::EMPTY_CELL);
+    check(pattern.events() == 0 && matches(pattern, reference), "Resizing down to nothing and back");
+
+    // Converting between the storages either way keeps the rows
+    for (int density : {2, 50, 98}) {
+        PatternData original(256, CAPACITY);
+        std::vector<TrackerCell> cells(256, PatternData::EMPTY_CELL);
+        for (size_t row = 0; row < cells.size(); row++)
+            if ((int)(random() % 100) < density) original.setCell(row, cells[row] = randomCell(random));
+        PatternData converted = original;
+        converted.optimize();
+        // Same sizes as PatternData::sparseBytes() and denseBytes()
+        size_t slots = CAPACITY * sizeof(EffectSlot);
+        bool expectSparse = original.events() * (sizeof(uint32_t) + 3 + slots) < cells.size() * (3 + slots);
+        check(converted.storage() == (expectSparse ? PatternData::Storage::Sparse : PatternData::Storage::Dense), "optimize() picks the storage by density");
+        check(matches(converted, cells) && converted == original, "The rows survive the conversion");
+        converted.optimize();
+        check(matches(converted, cells), "Converting twice changes nothing");
+
+        // Emptying most of it leaves it sparse, whichever storage it was in
+        for (size_t row = 0; row < cells.size(); row++)
+            if (row % 16) converted.setCell(row, cells[row] = PatternData::EMPTY_CELL);
+        converted.optimize();
+        check(converted.storage() == PatternData::Storage::Sparse && matches(converted, cells), "Emptied patterns go back to sparse");
+    }
+
+    printf(failures ? "%d failures\n" : "All tests passed\n", failures);
+    return failures != 0;
+}
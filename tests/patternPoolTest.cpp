@@ -0,0 +1,79 @@
+#include <cstdio>
+#include <vector>
+
+#include "../src/Song.cpp"
+#include "testUtils.hpp"
+
+// Checks that interning shares equal patterns and keeps
+// different ones (contents or effect capacities) apart,
+// that editing copies shared patterns instead of changing
+// them for everyone, and that songs with different effect
+// column amounts keep the capacity fitted before interning.
+
+TrackerCell cellWithEffects (uint8_t note, size_t effects) {
+    TrackerCell cell;
+    cell.noteValue = note;
+    for (size_t i = 0; i < effects; i++) cell.effects.push_back(EffectBase(i + 1, {(uint8_t)(0x10 + i)}));
+    return cell;
+}
+
+PatternData content (uint8_t effectCapacity) {
+    PatternData pattern(64, effectCapacity);
+    pattern.setCell(0, cellWithEffects(40, 0));
+    pattern.setCell(16, cellWithEffects(43, 0));
+    return pattern;
+}
+
+// A song using the pattern on channel 0 only
+Song songWithColumns (uint8_t effectColumns) {
+    Song song;
+    song.effectColumnAmount.fill(effectColumns);
+    TrackerPattern order {{0, 0, 0, 0, 0, 0, 0, 0}, {16}, {4}, 64};
+    song.patterns.push_back(order);
+    song.addPattern(content(2));
+    return song;
+}
+
+int main () {
+
+    // Sharing
+    auto a = PatternPool::intern(content(2)), b = PatternPool::intern(content(2));
+    check(a == b, "Equal patterns share the same data");
+    auto other = content(2);
+    other.setCell(1, cellWithEffects(50, 0));
+    check(PatternPool::intern(std::move(other)) != a, "Different rows are kept apart");
+    auto wider = PatternPool::intern(content(4));
+    check(wider != a && wider->effectCapacity() == 4, "Different effect capacities are kept apart");
+    check(PatternPool::intern(content(4)) == wider, "Equal capacities still share");
+
+    // Copy on write
+    Song first, second;
+    first.patternData.push_back(a);
+    second.patternData.push_back(a);
+    first.editPattern(0).setCell(2, cellWithEffects(45, 0));
+    check(first.patternData[0] != a && a->cell(2) == PatternData::EMPTY_CELL, "Editing copies a shared pattern");
+    check(second.patternData[0] == a, "The other song keeps the shared pattern");
+    auto * copy = first.patternData[0].get();
+    first.editPattern(0).setCell(3, cellWithEffects(46, 0));
+    check(first.patternData[0].get() == copy, "A private copy is edited in place");
+    first.internPatterns();
+    second.editPattern(0).setCell(2, cellWithEffects(45, 0));
+    second.editPattern(0).setCell(3, cellWithEffects(46, 0));
+    second.internPatterns();
+    check(first.patternData[0] == second.patternData[0], "Patterns edited the same way share again once interned");
+
+    // Loading: the capacities are fitted to the effect columns, then interned
+    Song narrow = songWithColumns(2), wide = songWithColumns(4);
+    for (auto * song : {&narrow, &wide}) {
+        song->fitEffectCapacities();
+        song->internPatterns();
+    }
+    check(narrow.patternData[0]->effectCapacity() == 2, "The narrow song keeps its capacity");
+    check(wide.patternData[0]->effectCapacity() == 4, "Interning doesn't shrink the wide song's capacity");
+    check(*narrow.patternData[0] == *wide.patternData[0], "Both still have the same rows");
+    wide.editPattern(0).setCell(5, cellWithEffects(48, 4));
+    check(wide.patternData[0]->cell(5).effects.size() == 4, "Every effect column can be edited after interning");
+
+    printf(failures ? "%d failures\n" : "All tests passed\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,155 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#define BITCONVERTER_ARRAY_CONVS
+#define BITCONVERTER_VECTOR_CONVS
+#include "../src/RIFFLoader.cpp"
+#include "testProjects.hpp"
+#include "testUtils.hpp"
+
+// Saves a project of several songs through Project::Save, the
+// way the editor does, and loads it back from the path: the
+// songs past the first have to stay lazy, which only works if
+// the table of contents saveRIFFFile lays out by hand matches
+// what ends up in the file. Then saves that project again with
+// those songs still lazy, so their chunks are copied through
+// from the first file, and checks the result the same way.
+// Last, checks that a note chunk that fails to decode is kept
+// as it is in the file, instead of what could be decoded of it,
+// and that files are only marked as version 1 if they have
+// compressed chunks, which older builds can't read.
+
+Song randomSong (std::mt19937 & random, size_t patterns, uint8_t effectColumns) {
+    Song song;
+    song.effectColumnAmount.fill(effectColumns);
+    for (size_t i = 0; i < patterns; i++)
+        song.addPattern(randomPattern(random, 64 + random() % 192, 33, effectColumns));
+    for (uint16_t i = 0; i + 8 <= patterns; i += 8)
+        song.patterns.push_back(TrackerPattern {{i, (uint16_t)(i + 1), (uint16_t)(i + 2), (uint16_t)(i + 3),
+            (uint16_t)(i + 4), (uint16_t)(i + 5), (uint16_t)(i + 6), (uint16_t)(i + 7)}, {16}, {4}, 64});
+    song.internPatterns();
+    return song;
+}
+
+// The version in the file's "ver " chunk, which comes first
+uint32_t fileVersion (const std::string & path) {
+    std::ifstream file(path, std::ios_base::binary);
+    uint8_t bytes[32] = {};
+    file.read((char *)bytes, sizeof(bytes));
+    return BitConverter::readUint32(bytes + 28);
+}
+
+bool sameSong (const Song & a, const Song & b) {
+    if (a.effectColumnAmount != b.effectColumnAmount || a.patterns != b.patterns || a.patternData.size() != b.patternData.size())
+        return false;
+    for (size_t i = 0; i < a.patternData.size(); i++)
+        if (*a.patternData[i] != *b.patternData[i]) return false;
+    return true;
+}
+
+void save (const Project & project, const std::string & path) {
+    std::ofstream file(path, std::ios_base::out | std::ios_base::binary);
+    project.Save(file);
+}
+
+// Loads the file, checking that only the first song gets decoded and that every song matches the original
+void checkLoad (const std::string & path, Project & original, Project & loaded, FILE * warnings) {
+    std::string what = "Loading " + path;
+    check(loaded.Load(path.c_str()) == 0, what.c_str());
+    check(loaded.songCount() == original.songCount(), "Every song is there");
+    check(loaded.isSongLoaded(0), "The first song is decoded right away");
+    for (size_t i = 1; i < loaded.songCount(); i++)
+        check(!loaded.isSongLoaded(i), "The other songs are left for later");
+    check(readAll(warnings).empty(), "The table of contents matches the file");
+    check(loaded.name() == original.name() && loaded.comments() == original.comments(), "The metadata survives");
+}
+
+int main () {
+    std::mt19937 random(4096);
+    auto directory = std::filesystem::temp_directory_path();
+    std::string first = (directory / "genecyzer-saveLoadTest-1.gczr").string();
+    std::string second = (directory / "genecyzer-saveLoadTest-2.gczr").string();
+
+    FILE * warnings = tmpfile();
+    Log::setOutput(stdout, warnings);
+
+    // Odd sizes everywhere, so that the padding bytes are laid out right too
+    Project original = Project::createDefault();
+    original.name() = "Odd";
+    original.songs.push_back(randomSong(random, 24, 2));
+    original.songs.push_back(randomSong(random, 17, 3));
+    original.songs.push_back(randomSong(random, 8, 1));
+    save(original, first);
+
+    Project loaded;
+    checkLoad(first, original, loaded, warnings);
+    for (size_t i = 0; i < original.songCount(); i++)
+        check(sameSong(loaded.song(i), original.songs[i]), "The songs survive the trip");
+
+    // Saving again with songs 1 and 2 still lazy copies their chunks through from the first file
+    Project lazy;
+    check(lazy.Load(first.c_str()) == 0, "Loading it again");
+    TrackerCell cell;
+    cell.noteValue = 40;
+    lazy.song(3).editPattern(0).setCell(1, cell);
+    original.songs[3].editPattern(0).setCell(1, cell);
+    check(!lazy.isSongLoaded(1) && !lazy.isSongLoaded(2), "Songs 1 and 2 are still lazy when saving");
+    save(lazy, second);
+
+    Project copied;
+    checkLoad(second, original, copied, warnings);
+    for (size_t i = 0; i < original.songCount(); i++)
+        check(sameSong(copied.song(i), original.songs[i]), "The copied through and the edited songs survive the trip");
+
+    // A truncated note chunk is loaded as far as it goes, but saved back whole
+    {
+        PatternData pattern(64, 2);
+        for (size_t row = 0; row < pattern.size(); row += 3) {
+            TrackerCell cell;
+            cell.noteValue = 30 + row % 40;
+            pattern.setCell(row, cell);
+        }
+        std::vector<uint8_t> broken = RIFFLoader::encodeNoteStruct(pattern);
+        broken.resize(broken.size() / 2);
+        std::vector<RIFFLoader::SongChunks> chunks(1);
+        chunks[0].notes.push_back(RIFFLoader::ChunkData {broken, false});
+        std::vector<Song> songs;
+        RIFFLoader::loadSongs(chunks, songs);
+        check(!readAll(warnings).empty(), "The broken chunk is reported");
+        auto cached = songs[0].cachedNoteChunk(0);
+        check(cached && cached->data == broken && !cached->compressed, "The broken chunk is saved back as it was");
+        songs[0].editPattern(0).setCell(0, TrackerCell());
+        check(!songs[0].cachedNoteChunk(0), "Until its pattern is edited");
+    }
+
+    // The version only goes up to 1 with compressed chunks
+    {
+        Project plain = Project::createDefault();
+        save(plain, first);
+        check(fileVersion(first) == 0, "Files without compressed chunks are version 0");
+
+        // Repeating rows compress well
+        PatternData repeating(256, 0);
+        for (size_t row = 0; row < repeating.size(); row++) {
+            TrackerCell cell;
+            cell.noteValue = 30 + row % 4;
+            cell.instrument = row % 3;
+            cell.hideInstrument(false);
+            repeating.setCell(row, cell);
+        }
+        plain.song(0).addPattern(std::move(repeating));
+        save(plain, first);
+        check(fileVersion(first) == 1, "Files with compressed chunks are version 1");
+    }
+
+    Log::setOutput(stdout, stderr);
+    fclose(warnings);
+    std::filesystem::remove(first);
+    std::filesystem::remove(second);
+    printf(failures ? "%d failures\n" : "All tests passed\n", failures);
+    return failures != 0;
+}
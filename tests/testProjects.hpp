@@ -0,0 +1,51 @@
+#ifndef __TEST_PROJECTS_INCLUDED__
+#define __TEST_PROJECTS_INCLUDED__
+
+#include <random>
+
+#include "../src/RIFFLoader.cpp"
+
+// Random patterns and projects for the tests and benchmarks:
+
+/*  Random notes are about the worst case for the note chunk
+    encoding and for compression, so they're what the save
+    and load benchmarks measure. Every pattern is interned,
+    as it would be after loading. Define the BitConverter
+    options RIFFLoader.cpp needs before including this.
+*/
+
+/**
+ * @brief A pattern of random notes and instruments
+ * @param density Percentage of the rows that aren't empty
+ */
+inline PatternData randomPattern (std::mt19937 & random, size_t rows, unsigned density = 25, uint8_t effectCapacity = 0) {
+    PatternData pattern(rows, effectCapacity);
+    for (size_t row = 0; row < rows; row++) {
+        if (random() % 100 >= density) continue;
+        TrackerCell cell;
+        cell.noteValue = random() % (TrackerCell::MAX_NOTE + 1);
+        cell.instrument = random() % 32;
+        cell.hideInstrument(false);
+        cell.attack(random() & 1);
+        pattern.setCell(row, cell);
+    }
+    return pattern;
+}
+
+/**
+ * @brief A project of songs with one effect column per channel, each played by one 8-channel pattern order
+ */
+inline Project randomProject (std::mt19937 & random, size_t songs, size_t patternsPerSong, size_t rows) {
+    Project project;
+    for (size_t song = 0; song < songs; song++) {
+        Song & output = project.songs.emplace_back();
+        output.effectColumnAmount.fill(1);
+        for (size_t i = 0; i < patternsPerSong; i++)
+            output.addPattern(randomPattern(random, rows));
+        output.patterns.push_back(TrackerPattern {{0, 1, 2, 3, 4, 5, 6, 7}, {16}, {4}, rows});
+        output.internPatterns();
+    }
+    return project;
+}
+
+#endif  // __TEST_PROJECTS_INCLUDED__
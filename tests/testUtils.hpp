@@ -0,0 +1,34 @@
+#ifndef __TEST_UTILS_INCLUDED__
+#define __TEST_UTILS_INCLUDED__
+
+#include <cstdio>
+#include <string>
+
+// Shared by the tests:
+
+/*  check() prints what failed and counts it in failures,
+    which main() reports and returns at the end:
+        printf(failures ? "%d failures\n" : "All tests passed\n", failures);
+        return failures != 0;
+    Only uses the standard library, so any test can include
+    it whatever it tests.
+*/
+
+inline int failures = 0;
+
+inline void check (bool condition, const char * what) {
+    if (!condition) { printf("FAIL: %s\n", what); failures++; }
+}
+
+// Everything written to a temporary file so far, e.g. one given to Log::setOutput()
+inline std::string readAll (FILE * file) {
+    fflush(file);
+    rewind(file);
+    std::string output;
+    char block[4096];
+    size_t read;
+    while ((read = fread(block, 1, sizeof(block), file)) > 0) output.append(block, read);
+    return output;
+}
+
+#endif  // __TEST_UTILS_INCLUDED__
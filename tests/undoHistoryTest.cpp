@@ -0,0 +1,155 @@
+#include <cstdio>
+#include <vector>
+
+#define BITCONVERTER_ARRAY_CONVS
+#define BITCONVERTER_VECTOR_CONVS
+#include "../src/RIFFLoader.cpp"
+#include "../src/UndoHistory.cpp"
+#include "testUtils.hpp"
+
+// Checks that undo and redo round-trip cell and pattern edits,
+// where bursts of edits are coalesced and where they aren't,
+// that a new edit drops the redo history, that the history
+// stays under its memory cap by dropping redo history first
+// and then the oldest commands, and that patterns only the
+// history keeps alive are counted as they change hands, once
+// the history next touches whole patterns.
+
+constexpr int64_t SECOND = UndoHistory::COALESCE_TIME;
+
+TrackerCell note (uint8_t value) {
+    TrackerCell cell;
+    cell.noteValue = value;
+    return cell;
+}
+
+uint8_t noteAt (Project & project, size_t pattern, size_t row) {
+    return project.song(0).patternData[pattern]->cell(row).noteValue;
+}
+
+PatternData filledPattern (size_t rows, uint8_t value) {
+    PatternData pattern(rows, 2);
+    for (size_t row = 0; row < rows; row++) pattern.setCell(row, note(value));
+    return pattern;
+}
+
+Project freshProject () {
+    Project project = Project::createDefault();
+    project.song(0).addPattern(PatternData(64, 2));
+    return project;
+}
+
+int main () {
+    const uint8_t EMPTY = PatternData::EMPTY_CELL.noteValue;
+
+    // Coalescing: within COALESCE_TIME of the last edit, same pattern, not broken
+    {
+        Project project = freshProject();
+        UndoHistory history;
+        history.setCell(project, 0, 0, 1, note(10), 0);
+        history.setCell(project, 0, 0, 2, note(11), SECOND / 2);
+        history.setCell(project, 0, 0, 1, note(12), SECOND);
+        history.setCell(project, 0, 0, 3, note(13), 2 * SECOND);
+        check(history.undoDepth() == 1, "Edits at most COALESCE_TIME apart are one command");
+        history.setCell(project, 0, 0, 4, note(14), 3 * SECOND + 1);
+        check(history.undoDepth() == 2, "An edit more than COALESCE_TIME later starts a new one");
+        history.breakCoalescing();
+        history.setCell(project, 0, 0, 5, note(15), 3 * SECOND + 2);
+        check(history.undoDepth() == 3, "breakCoalescing() starts a new one");
+        history.setCell(project, 0, 1, 5, note(16), 3 * SECOND + 3);
+        check(history.undoDepth() == 4, "An edit to another pattern starts a new one");
+        history.setCell(project, 0, 1, 5, note(16), 3 * SECOND + 4);
+        check(history.undoDepth() == 4, "Setting a cell to what it is records nothing");
+
+        uint64_t changes = history.changes();
+        for (int i = 0; i < 3; i++) history.undo(project);
+        check(history.changes() == changes + 3, "Undoing counts as a change");
+        check(noteAt(project, 0, 1) == 12 && noteAt(project, 0, 3) == 13 && noteAt(project, 0, 4) == EMPTY, "Undo stops at the command boundary");
+        history.undo(project);
+        check(noteAt(project, 0, 1) == EMPTY && noteAt(project, 0, 2) == EMPTY && noteAt(project, 0, 3) == EMPTY,
+            "A coalesced command undoes together, back to each cell's first before");
+        check(!history.undo(project) && history.redoDepth() == 4, "Nothing left to undo");
+
+        history.redo(project);
+        check(noteAt(project, 0, 1) == 12 && noteAt(project, 0, 2) == 11 && noteAt(project, 0, 3) == 13, "Redo reapplies each cell's last after");
+        while (history.redo(project));
+        check(noteAt(project, 0, 5) == 15 && noteAt(project, 1, 5) == 16, "Redo goes all the way back");
+
+        history.undo(project);
+        history.undo(project);
+        history.setCell(project, 0, 0, 6, note(17), 10 * SECOND);
+        check(!history.canRedo() && noteAt(project, 0, 5) == EMPTY && noteAt(project, 0, 6) == 17, "A new edit drops the redo history");
+    }
+
+    // Whole patterns
+    {
+        Project project = freshProject();
+        UndoHistory history;
+        auto original = project.song(0).patternData[0];
+        auto replacement = PatternPool::intern(filledPattern(32, 20));
+        history.replacePattern(project, 0, 0, replacement);
+        check(project.song(0).patternData[0] == replacement, "Replacing a pattern");
+        history.undo(project);
+        check(project.song(0).patternData[0] == original, "Undoing it puts the very same pattern back");
+        history.redo(project);
+        check(project.song(0).patternData[0] == replacement, "Redoing it too");
+        history.setCell(project, 0, 0, 0, note(21), 0);
+        check(replacement->cell(0).noteValue == 20, "Editing after a replace copies instead of changing the shared pattern");
+    }
+
+    // Patterns only the history keeps alive are counted, as they change hands
+    {
+        Project project = freshProject();
+        UndoHistory history;
+        auto big = filledPattern(4096, 30);
+        size_t patternBytes = big.memoryUsage();
+        project.song(0).setPattern(1, PatternPool::intern(std::move(big)));
+
+        size_t before = history.memoryUsage();
+        history.replacePattern(project, 0, 1, PatternPool::intern(PatternData(16, 2)));
+        check(history.memoryUsage() >= before + patternBytes, "The replaced pattern is counted");
+        history.undo(project);
+        check(history.memoryUsage() < before + patternBytes, "Not once it's back in the song");
+
+        // Shared with another song when recorded, then let go of there
+        auto shared = PatternPool::intern(filledPattern(4096, 31));
+        project.song(0).setPattern(1, shared);
+        Song other;
+        other.patternData.push_back(shared);
+        shared.reset();
+        history.replacePattern(project, 0, 1, PatternPool::intern(PatternData(16, 2)));
+        size_t whileShared = history.memoryUsage();
+        other.editPattern(0).setCell(0, note(32));
+        history.setCell(project, 0, 0, 0, note(33), 0);
+        check(history.memoryUsage() < whileShared + patternBytes, "Cell edits don't count the patterns again");
+        history.replacePattern(project, 0, 0, PatternPool::intern(PatternData(8, 2)));
+        check(history.memoryUsage() >= whileShared + patternBytes, "A pattern the history is left alone with is counted from the next replacement");
+    }
+
+    // The memory cap
+    {
+        Project project = freshProject();
+        UndoHistory history;
+        for (size_t row = 0; row < 64; row++) {
+            history.breakCoalescing();
+            history.setCell(project, 0, 0, row, note(40 + row % 40), 0);
+        }
+        size_t perCommand = history.memoryUsage() / 64;
+        for (int i = 0; i < 16; i++) history.undo(project);
+        history.setMemoryCap(perCommand * 56);
+        check(history.redoDepth() == 8 && history.undoDepth() == 48, "Redo history is dropped first");
+        history.setMemoryCap(perCommand * 20);
+        check(history.redoDepth() == 0 && history.undoDepth() == 20 && history.memoryUsage() <= perCommand * 20, "Then the oldest commands");
+        while (history.undo(project));
+        check(noteAt(project, 0, 27) == 40 + 27 && noteAt(project, 0, 28) == EMPTY, "Only the dropped commands stay applied");
+
+        history.setMemoryCap(1);
+        history.setCell(project, 0, 0, 0, note(50), 0);
+        check(history.undoDepth() == 1 && history.canUndo(), "The newest command is kept no matter its size");
+        history.clear();
+        check(history.memoryUsage() == 0 && !history.canUndo() && !history.canRedo(), "Clearing forgets everything");
+    }
+
+    printf(failures ? "%d failures\n" : "All tests passed\n", failures);
+    return failures != 0;
+}